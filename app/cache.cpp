@@ -5,8 +5,8 @@
 #include <vector>
 #include <thread>
 
+#include "cache/memoize.h"
 #include "hashmap/hashcombiner.h"
-#include "hashmap/hashmap.h"
 
 class custom_t {
 public:
@@ -48,19 +48,21 @@ struct std::hash<custom_t> {
 
 class CacheFunction {
 public:
+    // Threads missing on the same snapshot share a single computation.
     double change_ratio(const custom_t& snapshot) const {
-        std::optional<double> ret = hash_map.lookup_k(snapshot);
-        if (ret) {
-            return ret.value();
-        }
+        return memo(snapshot);
+    }
 
-        double ratio = snapshot.get_ratio();
-        hash_map.insert_kv(snapshot, ratio);
-        // std::this_thread::sleep_for(std::chrono::milliseconds(100));
-        return ratio;
+    MemoizeStats stats() const {
+        return memo.stats();
     }
 private:
-    mutable HashMap<custom_t, double, 1000, std::hash<custom_t>> hash_map;
+    static double compute_ratio(const custom_t& snapshot) {
+        // std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        return snapshot.get_ratio();
+    }
+
+    Memoize<double (*)(const custom_t&)> memo{&compute_ratio};
 };
 
 
@@ -144,6 +146,9 @@ int main() {
         std::cout << "Batch cache speedup: " << batch_speedup << "x" << std::endl;
     }
     
+    MemoizeStats stats = cache.stats();
+    std::cout << "Memo hits: " << stats.hits << " misses: " << stats.misses << " entries: " << stats.size << std::endl;
+
     std::cout << "\n✅ Cache function demo completed!" << std::endl;
     return 0;
 }
\ No newline at end of file
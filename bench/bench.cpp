@@ -0,0 +1,343 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <memory>
+#include <initializer_list>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "hashmap/hashmap.h"
+#include "hashmap/left_right_map.h"
+#include "hashmap/lockfree_map.h"
+#include "locks/rw_lock.h"
+
+// YCSB-style workload driver for HashMap, LockFreeHashMap, LeftRightMap and
+// RWLock.
+//
+//   bench [--target=chained|flat|lockfree|leftright|rwlock] [--workload=a|b|c|w|d] [--dist=uniform|zipf]
+//         [--keys=N] [--ops=N] [--threads=1,2,4] [--key-size=N] [--value-size=N]
+//         [--theta=0.99] [--format=table|csv|json]
+//
+// Workloads: a = 50% read / 50% update, b = 95/5, c = read only,
+// w = 5% read / 95% update, d = 90% read / 5% insert / 5% delete.
+// Every thread count in --threads runs the same workload on a freshly loaded
+// target and reports throughput plus p50/p99/p999 operation latency.
+
+namespace {
+
+struct Options {
+    std::string target = "chained";
+    std::string workload = "b";
+    std::string dist = "zipf";
+    size_t keys = 100000;
+    size_t ops = 200000;
+    std::vector<int> threads = {1, 2, 4};
+    size_t key_size = 16;
+    size_t value_size = 64;
+    double theta = 0.99;
+    std::string format = "table";
+};
+
+struct Mix {
+    int read;
+    int update;
+    int insert;
+    int remove;
+};
+
+struct Result {
+    int threads;
+    double seconds;
+    uint64_t ops;
+    double p50_ns;
+    double p99_ns;
+    double p999_ns;
+};
+
+Mix mix_for(const std::string& workload) {
+    if (workload == "a") return {50, 50, 0, 0};
+    if (workload == "c") return {100, 0, 0, 0};
+    if (workload == "w") return {5, 95, 0, 0};
+    if (workload == "d") return {90, 0, 5, 5};
+    return {95, 5, 0, 0};
+}
+
+// Zipfian generator from Gray et al., "Quickly Generating Billion-Record
+// Synthetic Databases", as used by YCSB. Ranks are scrambled with FNV so the
+// hottest keys are not neighbours.
+class ZipfianGenerator {
+public:
+    ZipfianGenerator(uint64_t n, double theta) : n(n), theta(theta) {
+        zetan = zeta(n, theta);
+        double zeta2 = zeta(2, theta);
+        alpha = 1.0 / (1.0 - theta);
+        eta = (1.0 - std::pow(2.0 / n, 1.0 - theta)) / (1.0 - zeta2 / zetan);
+    }
+
+    template <typename Rng>
+    uint64_t operator()(Rng& rng) const {
+        double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+        double uz = u * zetan;
+        uint64_t rank;
+        if (uz < 1.0) {
+            rank = 0;
+        } else if (uz < 1.0 + std::pow(0.5, theta)) {
+            rank = 1;
+        } else {
+            rank = static_cast<uint64_t>(n * std::pow(eta * u - eta + 1.0, alpha));
+        }
+        return fnv(std::min(rank, n - 1)) % n;
+    }
+
+private:
+    static double zeta(uint64_t n, double theta) {
+        double sum = 0;
+        for (uint64_t i = 1; i <= n; ++i) {
+            sum += 1.0 / std::pow(static_cast<double>(i), theta);
+        }
+        return sum;
+    }
+
+    static uint64_t fnv(uint64_t v) {
+        uint64_t h = 0xcbf29ce484222325ull;
+        for (int i = 0; i < 8; ++i) {
+            h = (h ^ (v & 0xff)) * 0x100000001b3ull;
+            v >>= 8;
+        }
+        return h;
+    }
+
+    uint64_t n;
+    double theta, zetan, alpha, eta;
+};
+
+std::string make_key(uint64_t id, size_t size) {
+    std::string key = "user" + std::to_string(id);
+    if (key.size() < size) {
+        key.insert(4, size - key.size(), '0');
+    }
+    return key;
+}
+
+double percentile(std::vector<uint32_t>& samples, double q) {
+    if (samples.empty()) {
+        return 0;
+    }
+    size_t idx = std::min(samples.size() - 1, static_cast<size_t>(q * samples.size()));
+    std::nth_element(samples.begin(), samples.begin() + idx, samples.end());
+    return samples[idx];
+}
+
+// Adapts the maps and RWLock to a common read/update/insert/remove interface.
+template <typename Map>
+struct MapTarget {
+    Map map;
+
+    void load(const std::vector<std::string>& keys, const std::string& value) {
+        for (const auto& key : keys) {
+            map.insert_kv(key, value);
+        }
+    }
+    void read(const std::string& key) { volatile bool found = map.lookup_k(key).has_value(); (void)found; }
+    void update(const std::string& key, const std::string& value) { map.insert_kv(key, value); }
+    void remove(const std::string& key) { map.delete_k(key); }
+};
+
+struct LockTarget {
+    RWLock lock;
+    uint64_t counter = 0;
+
+    void load(const std::vector<std::string>&, const std::string&) {}
+    void read(const std::string&) { volatile uint64_t v = lock.read([this]() { return counter; }); (void)v; }
+    void update(const std::string&, const std::string&) { lock.write([this]() { ++counter; }); }
+    void remove(const std::string&) { lock.write([this]() { --counter; }); }
+};
+
+template <typename Target>
+Result run_once(const Options& opt, const std::vector<std::string>& keys, int threads) {
+    auto target = std::make_unique<Target>();
+    std::string value(opt.value_size, 'v');
+    target->load(keys, value);
+
+    Mix mix = mix_for(opt.workload);
+    ZipfianGenerator zipf(keys.size(), opt.theta);
+    std::vector<std::vector<uint32_t>> latencies(threads);
+    std::atomic<int> ready{0};
+    std::atomic<bool> go{false};
+    uint64_t ops_per_thread = opt.ops / threads;
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t]() {
+            std::mt19937_64 rng(0x5eed + t);
+            std::uniform_int_distribution<uint64_t> uniform(0, keys.size() - 1);
+            std::uniform_int_distribution<int> op_dis(0, 99);
+            auto& samples = latencies[t];
+            samples.reserve(ops_per_thread);
+            ready++;
+            while (!go.load()) {
+                std::this_thread::yield();
+            }
+            for (uint64_t i = 0; i < ops_per_thread; ++i) {
+                const std::string& key = keys[opt.dist == "uniform" ? uniform(rng) : zipf(rng)];
+                int op = op_dis(rng);
+                auto start = std::chrono::steady_clock::now();
+                if (op < mix.read) {
+                    target->read(key);
+                } else if (op < mix.read + mix.update + mix.insert) {
+                    target->update(key, value);
+                } else {
+                    target->remove(key);
+                }
+                auto end = std::chrono::steady_clock::now();
+                samples.push_back(static_cast<uint32_t>(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count()));
+            }
+        });
+    }
+    while (ready.load() < threads) {
+        std::this_thread::yield();
+    }
+    auto start = std::chrono::steady_clock::now();
+    go = true;
+    for (auto& w : workers) {
+        w.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<uint32_t> all;
+    for (auto& samples : latencies) {
+        all.insert(all.end(), samples.begin(), samples.end());
+    }
+    return Result{threads, seconds, ops_per_thread * threads,
+                  percentile(all, 0.50), percentile(all, 0.99), percentile(all, 0.999)};
+}
+
+std::vector<int> parse_threads(const std::string& list) {
+    std::vector<int> threads;
+    std::stringstream ss(list);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        threads.push_back(std::max(1, std::stoi(item)));
+    }
+    return threads;
+}
+
+bool one_of(const std::string& value, std::initializer_list<const char*> allowed) {
+    return std::any_of(allowed.begin(), allowed.end(), [&](const char* a) { return value == a; });
+}
+
+// Rejects unknown names and values rather than running (and labelling the
+// output with) a configuration other than the one asked for.
+bool parse(int argc, char** argv, Options& opt) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        size_t eq = arg.find('=');
+        if (arg.rfind("--", 0) != 0 || eq == std::string::npos) {
+            return false;
+        }
+        std::string name = arg.substr(2, eq - 2);
+        std::string value = arg.substr(eq + 1);
+        if (name == "target") opt.target = value;
+        else if (name == "workload") opt.workload = value;
+        else if (name == "dist") opt.dist = value;
+        else if (name == "format") opt.format = value;
+        else {
+            // Numeric options; std::sto* throw on malformed numbers.
+            try {
+                if (name == "keys") opt.keys = std::max<size_t>(2, std::stoull(value));
+                else if (name == "ops") opt.ops = std::stoull(value);
+                else if (name == "threads") opt.threads = parse_threads(value);
+                else if (name == "key-size") opt.key_size = std::stoull(value);
+                else if (name == "value-size") opt.value_size = std::stoull(value);
+                else if (name == "theta") opt.theta = std::stod(value);
+                else return false;
+            } catch (const std::exception&) {
+                return false;
+            }
+        }
+    }
+    return one_of(opt.target, {"chained", "flat", "lockfree", "leftright", "rwlock"}) &&
+           one_of(opt.workload, {"a", "b", "c", "w", "d"}) && one_of(opt.dist, {"uniform", "zipf"}) &&
+           one_of(opt.format, {"table", "csv", "json"}) && !opt.threads.empty();
+}
+
+void report(const Options& opt, const std::vector<Result>& results) {
+    if (opt.format == "csv") {
+        std::cout << "target,workload,dist,keys,key_size,value_size,threads,ops,seconds,ops_per_sec,p50_ns,p99_ns,p999_ns\n";
+        for (const auto& r : results) {
+            std::cout << opt.target << ',' << opt.workload << ',' << opt.dist << ',' << opt.keys << ','
+                      << opt.key_size << ',' << opt.value_size << ',' << r.threads << ',' << r.ops << ','
+                      << r.seconds << ',' << r.ops / r.seconds << ',' << r.p50_ns << ',' << r.p99_ns << ','
+                      << r.p999_ns << '\n';
+        }
+    } else if (opt.format == "json") {
+        std::cout << "{\"target\":\"" << opt.target << "\",\"workload\":\"" << opt.workload
+                  << "\",\"dist\":\"" << opt.dist << "\",\"keys\":" << opt.keys
+                  << ",\"key_size\":" << opt.key_size << ",\"value_size\":" << opt.value_size
+                  << ",\"results\":[";
+        for (size_t i = 0; i < results.size(); ++i) {
+            const auto& r = results[i];
+            std::cout << (i ? "," : "") << "{\"threads\":" << r.threads << ",\"ops\":" << r.ops
+                      << ",\"seconds\":" << r.seconds << ",\"ops_per_sec\":" << r.ops / r.seconds
+                      << ",\"p50_ns\":" << r.p50_ns << ",\"p99_ns\":" << r.p99_ns
+                      << ",\"p999_ns\":" << r.p999_ns << "}";
+        }
+        std::cout << "]}\n";
+    } else {
+        std::cout << "=== " << opt.target << " workload=" << opt.workload << " dist=" << opt.dist
+                  << " keys=" << opt.keys << " ===" << std::endl;
+        std::printf("%8s %14s %10s %10s %10s\n", "threads", "ops/sec", "p50(ns)", "p99(ns)", "p999(ns)");
+        for (const auto& r : results) {
+            std::printf("%8d %14.0f %10.0f %10.0f %10.0f\n", r.threads, r.ops / r.seconds, r.p50_ns, r.p99_ns,
+                        r.p999_ns);
+        }
+    }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options opt;
+    if (!parse(argc, argv, opt)) {
+        std::cerr << "usage: bench [--target=chained|flat|lockfree|leftright|rwlock] [--workload=a|b|c|w|d] "
+                     "[--dist=uniform|zipf] [--keys=N] [--ops=N] [--threads=1,2,4] [--key-size=N] "
+                     "[--value-size=N] [--theta=0.99] [--format=table|csv|json]"
+                  << std::endl;
+        return 1;
+    }
+
+    std::vector<std::string> keys;
+    keys.reserve(opt.keys);
+    for (size_t i = 0; i < opt.keys; ++i) {
+        keys.push_back(make_key(i, opt.key_size));
+    }
+
+    using Chained = HashMap<std::string, std::string, 1000>;
+    using Flat = HashMap<std::string, std::string, 1000, DefaultHash<std::string>, std::equal_to<std::string>, FlatTable>;
+
+    std::vector<Result> results;
+    for (int threads : opt.threads) {
+        if (opt.target == "flat") {
+            results.push_back(run_once<MapTarget<Flat>>(opt, keys, threads));
+        } else if (opt.target == "lockfree") {
+            results.push_back(run_once<MapTarget<LockFreeHashMap<std::string, std::string>>>(opt, keys, threads));
+        } else if (opt.target == "leftright") {
+            results.push_back(run_once<MapTarget<LeftRightMap<std::string, std::string>>>(opt, keys, threads));
+        } else if (opt.target == "rwlock") {
+            results.push_back(run_once<LockTarget>(opt, keys, threads));
+        } else {
+            results.push_back(run_once<MapTarget<Chained>>(opt, keys, threads));
+        }
+    }
+    report(opt, results);
+    return 0;
+}
@@ -0,0 +1,168 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <vector>
+
+#include "cache/eviction.h"
+#include "hashmap/chained_table.h"
+#include "hashmap/hash.h"
+#include "locks/rw_lock.h"
+
+// Default weigher: every entry costs one unit, so the budget is an entry count.
+struct UnitWeigher {
+    template <typename K, typename V>
+    size_t operator()(const K&, const V&) const {
+        return 1;
+    }
+};
+
+struct CacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    size_t size = 0;
+    size_t weight = 0;
+    size_t capacity = 0;
+};
+
+// Size-bounded cache with the same sharded layout as HashMap: SZ cache-line
+// aligned shards, each a RWLock plus a ChainedTable. The capacity (in Weigher
+// units, e.g. bytes) is split across shards, the first capacity % SZ shards
+// taking one unit more, so the shares add up to exactly the capacity; with a
+// capacity below SZ some shards get nothing and never keep an entry. Every
+// shard evicts on its own, according to its Policy instance, once an insert
+// pushes it over its share. Hits only take the shard's read lock.
+template <typename K, typename V, int SZ = 64, typename Hash = DefaultHash<K>,
+          template <typename> class Policy = ClockPolicy, typename Weigher = UnitWeigher>
+class BoundedCache {
+    static_assert(SZ > 0, "BoundedCache needs at least one shard");
+
+public:
+    explicit BoundedCache(size_t capacity, Weigher weigher = Weigher())
+        : weigher(weigher), shards(SZ), total_capacity(capacity) {
+        for (size_t i = 0; i < shards.size(); ++i) {
+            shards[i].capacity = capacity / SZ + (i < capacity % SZ ? 1 : 0);
+            shards[i].policy.set_capacity(shards[i].capacity);
+        }
+    }
+
+    std::optional<V> lookup_k(const K& key) {
+        size_t hash_val = hasher(key);
+        Shard& shard = shard_for(hash_val);
+        std::optional<V> result = shard.lock.read([&]() -> std::optional<V> {
+            if (const Entry* entry = shard.table.find(key, hash_val)) {
+                shard.policy.on_hit(hash_val, entry->meta);
+                return entry->value;
+            }
+            return std::nullopt;
+        });
+        (result ? shard.hits : shard.misses).fetch_add(1, std::memory_order_relaxed);
+        return result;
+    }
+
+    void insert_kv(const K& key, const V& value) {
+        size_t hash_val = hasher(key);
+        Shard& shard = shard_for(hash_val);
+        size_t weight = weigher(key, value);
+        shard.lock.write([&]() {
+            // One probe: the entry is only constructed if the key is new.
+            auto [entry, inserted] = shard.table.try_emplace(key, hash_val, value, weight);
+            if (inserted) {
+                auto lookup = meta_lookup(shard);
+                shard.policy.on_insert(key, hash_val, entry->meta, lookup);
+                shard.weight += weight;
+            } else {
+                shard.weight = shard.weight - entry->weight + weight;
+                entry->value = value;
+                entry->weight = weight;
+            }
+            evict_over_budget(shard);
+        });
+    }
+
+    bool delete_k(const K& key) {
+        size_t hash_val = hasher(key);
+        Shard& shard = shard_for(hash_val);
+        return shard.lock.write([&]() -> bool {
+            Entry* entry = shard.table.find(key, hash_val);
+            if (!entry) {
+                return false;
+            }
+            remove(shard, key, hash_val, *entry);
+            return true;
+        });
+    }
+
+    CacheStats stats() {
+        CacheStats total;
+        total.capacity = total_capacity;
+        for (auto& shard : shards) {
+            total.hits += shard.hits.load(std::memory_order_relaxed);
+            total.misses += shard.misses.load(std::memory_order_relaxed);
+            total.evictions += shard.evictions.load(std::memory_order_relaxed);
+            shard.lock.read([&]() {
+                total.size += shard.table.size();
+                total.weight += shard.weight;
+            });
+        }
+        return total;
+    }
+
+private:
+    struct Entry {
+        Entry(const V& value, size_t weight) : value(value), weight(weight) {}
+
+        V value;
+        EvictionMeta meta;
+        size_t weight;
+    };
+
+    struct alignas(kCacheLineSize) Shard {
+        RWLock lock;
+        ChainedTable<K, Entry, Hash> table;
+        Policy<K> policy;
+        size_t weight = 0;
+        size_t capacity = 0;
+        std::atomic<uint64_t> hits{0};
+        std::atomic<uint64_t> misses{0};
+        std::atomic<uint64_t> evictions{0};
+    };
+
+    Shard& shard_for(size_t hash_val) {
+        return shards[reduce_hash<SZ>(hash_val)];
+    }
+
+    static auto meta_lookup(Shard& shard) {
+        return [&shard](const K& key, size_t hash_val) -> EvictionMeta* {
+            Entry* entry = shard.table.find(key, hash_val);
+            return entry ? &entry->meta : nullptr;
+        };
+    }
+
+    void remove(Shard& shard, const K& key, size_t hash_val, Entry& entry) {
+        shard.policy.on_erase(entry.meta);
+        shard.weight -= entry.weight;
+        shard.table.erase(key, hash_val);
+    }
+
+    void evict_over_budget(Shard& shard) {
+        auto lookup = meta_lookup(shard);
+        while (shard.weight > shard.capacity) {
+            std::optional<K> victim = shard.policy.victim(lookup);
+            if (!victim) {
+                break;
+            }
+            size_t hash_val = hasher(*victim);
+            remove(shard, *victim, hash_val, *shard.table.find(*victim, hash_val));
+            shard.evictions.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    Hash hasher;
+    Weigher weigher;
+    std::vector<Shard> shards;
+    size_t total_capacity;
+};
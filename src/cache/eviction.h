@@ -0,0 +1,383 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+// Eviction policies for BoundedCache. One policy instance lives in every cache
+// shard. on_hit runs under the shard's read lock and may only touch relaxed
+// atomics (a reference bit, a small frequency counter, a sketch counter); all
+// other calls run under the shard's write lock. Queues are never relinked on
+// a hit: policies keep FIFO queues of (key, stamp) records, skip records whose
+// entry was deleted or replaced, and compact when stale records pile up.
+
+// Relaxed atomic that can still be copied and moved along with its entry.
+template <typename T>
+class RelaxedAtomic {
+public:
+    RelaxedAtomic(T v = T()) : value(v) {}
+    RelaxedAtomic(const RelaxedAtomic& other) : value(other.load()) {}
+    RelaxedAtomic& operator=(const RelaxedAtomic& other) {
+        store(other.load());
+        return *this;
+    }
+
+    T load() const {
+        return value.load(std::memory_order_relaxed);
+    }
+
+    void store(T v) {
+        value.store(v, std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<T> value;
+};
+
+// Per-entry bookkeeping shared by all policies.
+struct EvictionMeta {
+    RelaxedAtomic<uint8_t> freq;  // reference bit (CLOCK) or saturating access count
+    uint64_t stamp = 0;           // matches the entry's queue record while it is live
+    uint8_t queue = 0;            // which policy queue currently owns the entry
+};
+
+namespace eviction_detail {
+
+// FIFO of (key, hash, stamp) records with lazy deletion.
+template <typename K>
+class StampedQueue {
+public:
+    struct Record {
+        K key;
+        size_t hash;
+        uint64_t stamp;
+    };
+
+    void push(const K& key, size_t hash, uint64_t stamp) {
+        records.push_back(Record{key, hash, stamp});
+    }
+
+    // Pops records until one still refers to a live entry owned by `queue`.
+    template <typename Lookup>
+    std::optional<std::pair<Record, EvictionMeta*>> pop_live(Lookup& lookup, uint8_t queue) {
+        while (!records.empty()) {
+            Record rec = std::move(records.front());
+            records.pop_front();
+            EvictionMeta* meta = lookup(rec.key, rec.hash);
+            if (meta && meta->stamp == rec.stamp && meta->queue == queue) {
+                return std::make_pair(std::move(rec), meta);
+            }
+        }
+        return std::nullopt;
+    }
+
+    // Drops stale records once they outnumber the live ones.
+    template <typename Lookup>
+    void maybe_compact(Lookup& lookup, size_t live, uint8_t queue) {
+        if (records.size() <= 2 * live + 32) {
+            return;
+        }
+        std::deque<Record> kept;
+        for (auto& rec : records) {
+            EvictionMeta* meta = lookup(rec.key, rec.hash);
+            if (meta && meta->stamp == rec.stamp && meta->queue == queue) {
+                kept.push_back(std::move(rec));
+            }
+        }
+        records.swap(kept);
+    }
+
+private:
+    std::deque<Record> records;
+};
+
+}  // namespace eviction_detail
+
+// CLOCK (second chance): a hit sets a reference bit; the hand clears set bits
+// and evicts the first entry found without one.
+template <typename K>
+class ClockPolicy {
+public:
+    void set_capacity(size_t) {}
+
+    void on_hit(size_t, const EvictionMeta& meta) const {
+        if (meta.freq.load() == 0) {
+            const_cast<EvictionMeta&>(meta).freq.store(1);
+        }
+    }
+
+    template <typename Lookup>
+    void on_insert(const K& key, size_t hash, EvictionMeta& meta, Lookup& lookup) {
+        meta.freq.store(0);
+        meta.stamp = ++next_stamp;
+        meta.queue = kRing;
+        ring.push(key, hash, meta.stamp);
+        ++live;
+        ring.maybe_compact(lookup, live, kRing);
+    }
+
+    void on_erase(const EvictionMeta&) {
+        --live;
+    }
+
+    template <typename Lookup>
+    std::optional<K> victim(Lookup& lookup) {
+        while (auto popped = ring.pop_live(lookup, kRing)) {
+            auto& [rec, meta] = *popped;
+            if (meta->freq.load() == 0) {
+                return std::move(rec.key);
+            }
+            meta->freq.store(0);
+            meta->stamp = ++next_stamp;
+            ring.push(rec.key, rec.hash, meta->stamp);
+        }
+        return std::nullopt;
+    }
+
+private:
+    static constexpr uint8_t kRing = 1;
+
+    eviction_detail::StampedQueue<K> ring;
+    uint64_t next_stamp = 0;
+    size_t live = 0;
+};
+
+// S3-FIFO: new entries go to a small FIFO (10% of entries); those hit more
+// than once there graduate to the main FIFO, the rest are evicted and leave a
+// hash in a ghost FIFO so that a quick re-insert goes straight to main. The
+// main FIFO gives entries with a non-zero counter another lap.
+template <typename K>
+class S3FifoPolicy {
+public:
+    void set_capacity(size_t) {}
+
+    void on_hit(size_t, const EvictionMeta& meta) const {
+        uint8_t f = meta.freq.load();
+        if (f < 3) {
+            const_cast<EvictionMeta&>(meta).freq.store(f + 1);
+        }
+    }
+
+    template <typename Lookup>
+    void on_insert(const K& key, size_t hash, EvictionMeta& meta, Lookup& lookup) {
+        meta.freq.store(0);
+        meta.stamp = ++next_stamp;
+        if (ghost_set.erase(hash)) {
+            meta.queue = kMain;
+            main.push(key, hash, meta.stamp);
+            ++main_live;
+            main.maybe_compact(lookup, main_live, kMain);
+        } else {
+            meta.queue = kSmall;
+            small.push(key, hash, meta.stamp);
+            ++small_live;
+            small.maybe_compact(lookup, small_live, kSmall);
+        }
+    }
+
+    void on_erase(const EvictionMeta& meta) {
+        (meta.queue == kSmall ? small_live : main_live) -= 1;
+    }
+
+    template <typename Lookup>
+    std::optional<K> victim(Lookup& lookup) {
+        while (small_live + main_live > 0) {
+            if (small_live > 0 && (small_live * 10 >= small_live + main_live || main_live == 0)) {
+                auto popped = small.pop_live(lookup, kSmall);
+                auto& [rec, meta] = *popped;
+                if (meta->freq.load() > 1) {
+                    --small_live;
+                    ++main_live;
+                    meta->freq.store(0);
+                    meta->queue = kMain;
+                    meta->stamp = ++next_stamp;
+                    main.push(rec.key, rec.hash, meta->stamp);
+                    continue;
+                }
+                remember(rec.hash);
+                return std::move(rec.key);
+            }
+            auto popped = main.pop_live(lookup, kMain);
+            auto& [rec, meta] = *popped;
+            uint8_t f = meta->freq.load();
+            if (f == 0) {
+                return std::move(rec.key);
+            }
+            meta->freq.store(f - 1);
+            meta->stamp = ++next_stamp;
+            main.push(rec.key, rec.hash, meta->stamp);
+        }
+        return std::nullopt;
+    }
+
+private:
+    static constexpr uint8_t kSmall = 1;
+    static constexpr uint8_t kMain = 2;
+
+    void remember(size_t hash) {
+        if (ghost_set.insert(hash).second) {
+            ghost.push_back(hash);
+        }
+        size_t limit = std::max<size_t>(main_live, 16);
+        while (ghost.size() > limit) {
+            ghost_set.erase(ghost.front());
+            ghost.pop_front();
+        }
+    }
+
+    eviction_detail::StampedQueue<K> small;
+    eviction_detail::StampedQueue<K> main;
+    std::deque<size_t> ghost;
+    std::unordered_set<size_t> ghost_set;
+    uint64_t next_stamp = 0;
+    size_t small_live = 0;
+    size_t main_live = 0;
+};
+
+// W-TinyLFU: a small admission window (1% of the entries held) in front of a
+// main region, both scanned CLOCK-style. An entry leaving the window only replaces
+// the main region's victim when a count-min sketch says it is accessed more
+// often. Hits bump the sketch with relaxed stores and the counters are halved
+// periodically so old popularity fades.
+template <typename K>
+class TinyLfuPolicy {
+public:
+    TinyLfuPolicy() : sketch(kRows * kWidth) {}
+
+    // The budget may be in bytes (see BoundedCache's Weigher), so the window
+    // is sized from the live entry count in victim() instead.
+    void set_capacity(size_t) {}
+
+    void on_hit(size_t hash, const EvictionMeta& meta) const {
+        if (meta.freq.load() == 0) {
+            const_cast<EvictionMeta&>(meta).freq.store(1);
+        }
+        const_cast<TinyLfuPolicy*>(this)->record(hash);
+    }
+
+    template <typename Lookup>
+    void on_insert(const K& key, size_t hash, EvictionMeta& meta, Lookup& lookup) {
+        record(hash);
+        meta.freq.store(0);
+        meta.stamp = ++next_stamp;
+        meta.queue = kWindow;
+        window.push(key, hash, meta.stamp);
+        ++window_live;
+        window.maybe_compact(lookup, window_live, kWindow);
+    }
+
+    void on_erase(const EvictionMeta& meta) {
+        (meta.queue == kWindow ? window_live : main_live) -= 1;
+    }
+
+    template <typename Lookup>
+    std::optional<K> victim(Lookup& lookup) {
+        size_t window_target = std::max<size_t>(1, (window_live + main_live) / 100);
+        if (main_live == 0) {
+            // Nothing admitted yet (or main was emptied by deletes): the
+            // window's overflow moves to main without a contest, as it would
+            // have while the cache still had room.
+            while (window_live > window_target) {
+                auto entry = next_clock(window, lookup, kWindow);
+                --window_live;
+                ++main_live;
+                move_to(main, entry, kMain);
+            }
+        }
+        while (window_live + main_live > 0) {
+            if (window_live > window_target || main_live == 0) {
+                auto candidate = next_clock(window, lookup, kWindow);
+                if (main_live == 0) {
+                    return std::move(candidate.first.key);
+                }
+                auto defender = next_clock(main, lookup, kMain);
+                if (estimate(candidate.first.hash) > estimate(defender.first.hash)) {
+                    --window_live;
+                    ++main_live;
+                    move_to(main, candidate, kMain);
+                    return std::move(defender.first.key);
+                }
+                move_to(main, defender, kMain);
+                return std::move(candidate.first.key);
+            }
+            return std::move(next_clock(main, lookup, kMain).first.key);
+        }
+        return std::nullopt;
+    }
+
+private:
+    using Record = typename eviction_detail::StampedQueue<K>::Record;
+
+    static constexpr uint8_t kWindow = 1;
+    static constexpr uint8_t kMain = 2;
+    static constexpr size_t kRows = 4;
+    static constexpr size_t kWidth = 1024;
+    static constexpr uint8_t kMaxCount = 15;
+    static constexpr uint32_t kResetInterval = 10 * kWidth;
+
+    static size_t slot(size_t hash, size_t row) {
+        uint64_t h = (static_cast<uint64_t>(hash) + row) * 0x9E3779B97F4A7C15ull;
+        return row * kWidth + static_cast<size_t>(h >> 54);
+    }
+
+    void record(size_t hash) {
+        for (size_t row = 0; row < kRows; ++row) {
+            auto& counter = sketch[slot(hash, row)];
+            uint8_t c = counter.load();
+            if (c < kMaxCount) {
+                counter.store(c + 1);
+            }
+        }
+        uint32_t n = additions.load() + 1;
+        additions.store(n);
+        if (n >= kResetInterval) {
+            additions.store(0);
+            for (auto& counter : sketch) {
+                counter.store(counter.load() / 2);
+            }
+        }
+    }
+
+    uint8_t estimate(size_t hash) const {
+        uint8_t best = kMaxCount;
+        for (size_t row = 0; row < kRows; ++row) {
+            best = std::min(best, sketch[slot(hash, row)].load());
+        }
+        return best;
+    }
+
+    // Second-chance scan of `queue`; the returned entry has been popped.
+    template <typename Lookup>
+    std::pair<Record, EvictionMeta*> next_clock(eviction_detail::StampedQueue<K>& queue, Lookup& lookup,
+                                                uint8_t id) {
+        while (true) {
+            auto popped = queue.pop_live(lookup, id);
+            auto& [rec, meta] = *popped;
+            if (meta->freq.load() == 0) {
+                return std::move(*popped);
+            }
+            meta->freq.store(0);
+            meta->stamp = ++next_stamp;
+            queue.push(rec.key, rec.hash, meta->stamp);
+        }
+    }
+
+    void move_to(eviction_detail::StampedQueue<K>& queue, std::pair<Record, EvictionMeta*>& entry, uint8_t id) {
+        entry.second->queue = id;
+        entry.second->stamp = ++next_stamp;
+        queue.push(entry.first.key, entry.first.hash, entry.second->stamp);
+    }
+
+    std::vector<RelaxedAtomic<uint8_t>> sketch;
+    RelaxedAtomic<uint32_t> additions;
+    eviction_detail::StampedQueue<K> window;
+    eviction_detail::StampedQueue<K> main;
+    uint64_t next_stamp = 0;
+    size_t window_live = 0;
+    size_t main_live = 0;
+};
@@ -0,0 +1,123 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "hashmap/hashcombiner.h"
+#include "hashmap/hashmap.h"
+
+struct MemoizeStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    size_t size = 0;
+};
+
+namespace memoize_detail {
+
+// Parameter and result types of a callable with one non-template call
+// operator, a function or a function pointer.
+template <typename F>
+struct Signature : Signature<decltype(&F::operator())> {};
+
+template <typename R, typename... A>
+struct Signature<R(A...)> {
+    using Result = std::decay_t<R>;
+    using Args = std::tuple<std::decay_t<A>...>;
+};
+
+template <typename R, typename... A>
+struct Signature<R(A...) noexcept> : Signature<R(A...)> {};
+
+template <typename R, typename... A>
+struct Signature<R (*)(A...)> : Signature<R(A...)> {};
+
+template <typename R, typename... A>
+struct Signature<R (*)(A...) noexcept> : Signature<R(A...)> {};
+
+template <typename C, typename R, typename... A>
+struct Signature<R (C::*)(A...) const> : Signature<R(A...)> {};
+
+template <typename C, typename R, typename... A>
+struct Signature<R (C::*)(A...) const noexcept> : Signature<R(A...)> {};
+
+}  // namespace memoize_detail
+
+template <typename F, int SZ = 64, typename Args = typename memoize_detail::Signature<F>::Args>
+class Memoize;
+
+// Caches the results of a pure function, keyed by its (decayed) argument
+// tuple. The key is hashed field by field with HashCombiner, so argument
+// types only need a DefaultHash (strings, integers, tuples, pairs, anything
+// with std::hash) and equality; no key struct or hasher has to be written.
+//
+// Hits are looked up through a tuple of references to the arguments, so no
+// key is built; a miss copies the arguments into the key and computes once
+// through HashMap::get_or_compute, so concurrent callers missing on the same
+// arguments share one call. Hit and miss counts are kept per Memoize on
+// per-thread stripes and reported by stats().
+//
+// F must have a single, non-template call operator (or be a function
+// pointer); wrap generic lambdas in one with explicit parameter types.
+//
+//     Memoize ratio([](const std::string& tick, uint64_t from, uint64_t to) { ... });
+//     double r = ratio("AAPL", 1000, 2000);
+template <typename F, int SZ, typename... Args>
+class Memoize<F, SZ, std::tuple<Args...>> {
+public:
+    using Key = std::tuple<Args...>;
+    using Result = typename memoize_detail::Signature<F>::Result;
+
+    static constexpr size_t kStripes = 16;
+
+    explicit Memoize(F fn) : fn(std::move(fn)) {}
+
+    Result operator()(const Args&... args) const {
+        if (std::optional<Result> hit = cache.lookup_k(std::forward_as_tuple(args...))) {
+            stripe().hits.fetch_add(1, std::memory_order_relaxed);
+            return std::move(*hit);
+        }
+        stripe().misses.fetch_add(1, std::memory_order_relaxed);
+        return cache.get_or_compute(Key(args...), [this](const Key& key) { return std::apply(fn, key); });
+    }
+
+    MemoizeStats stats() const {
+        MemoizeStats s;
+        for (const Stripe& st : stripes) {
+            s.hits += st.hits.load(std::memory_order_relaxed);
+            s.misses += st.misses.load(std::memory_order_relaxed);
+        }
+        s.size = cache.size();
+        return s;
+    }
+
+    // Drops every cached result; the counters keep running.
+    void clear() {
+        cache.erase_if([](const Key&, const Result&) { return true; });
+    }
+
+private:
+    struct alignas(kCacheLineSize) Stripe {
+        std::atomic<uint64_t> hits{0};
+        std::atomic<uint64_t> misses{0};
+    };
+
+    using Map = HashMap<Key, Result, SZ, DefaultHash<Key>, std::equal_to<>>;
+
+    Stripe& stripe() const {
+        thread_local size_t index = std::hash<std::thread::id>()(std::this_thread::get_id()) % kStripes;
+        return stripes[index];
+    }
+
+    F fn;
+    mutable Map cache;
+    mutable Stripe stripes[kStripes];
+};
+
+template <typename F>
+Memoize(F) -> Memoize<F>;
@@ -0,0 +1,277 @@
+#pragma once
+#include <algorithm>
+#include <vector>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <scoped_allocator>
+
+#include "hashmap/stats.h"
+
+// Separate-chaining table used as the storage of a single HashMap shard.
+// The bucket array is a power of two and follows the load factor in both
+// directions. Resizing is incremental: a second bucket array is allocated and
+// every mutating call migrates a handful of old buckets, so no single insert
+// pays for rehashing the whole shard. Lookups check both arrays meanwhile.
+//
+// Every entry keeps its full hash: chain scans compare hashes before keys, and
+// rehashing moves entries without calling the hasher again.
+//
+// Bucket arrays and chains come from Allocator (rebound as needed); the outer
+// array hands it down to every chain via std::scoped_allocator_adaptor.
+//
+// Not thread-safe on its own; the owning shard's lock serializes writers.
+template <typename K, typename V, typename Hash, typename KeyEqual = std::equal_to<K>,
+          typename Allocator = std::allocator<std::pair<const K, V>>>
+class ChainedTable {
+public:
+    struct Node {
+        template <typename KK, typename... Args>
+        Node(size_t hash, KK&& key, Args&&... args)
+            : first(std::forward<KK>(key)), second(std::forward<Args>(args)...), hash(hash) {}
+
+        K first;
+        V second;
+        size_t hash;
+    };
+    using Bucket = std::vector<Node, typename std::allocator_traits<Allocator>::template rebind_alloc<Node>>;
+    using BucketArray = std::vector<
+        Bucket, std::scoped_allocator_adaptor<typename std::allocator_traits<Allocator>::template rebind_alloc<Bucket>>>;
+
+    static constexpr size_t kMinBuckets = 8;
+    static constexpr size_t kRehashStep = 4;
+    static constexpr double kMaxLoadFactor = 1.0;
+    static constexpr double kMinLoadFactor = 0.125;
+    // Buckets are freed while rehashing, so unlocked readers are never safe.
+    static constexpr bool kOptimisticReads = false;
+
+    explicit ChainedTable(const Allocator& alloc = Allocator())
+        : tables{BucketArray(typename BucketArray::allocator_type(alloc)),
+                 BucketArray(typename BucketArray::allocator_type(alloc))} {
+        tables[0].resize(kMinBuckets);
+    }
+
+    // `key` may be any type KeyEqual can compare against K (heterogeneous lookup).
+    template <typename Q>
+    V* find(const Q& key, size_t hash) {
+        return const_cast<V*>(static_cast<const ChainedTable*>(this)->find(key, hash));
+    }
+
+    template <typename Q>
+    const V* find(const Q& key, size_t hash) const {
+        for (int t = 0; t < (rehashing() ? 2 : 1); ++t) {
+            for (const Node& node : bucket_for(t, hash)) {
+                if (node.hash == hash && eq(node.first, key)) {
+                    return &node.second;
+                }
+            }
+        }
+        return nullptr;
+    }
+
+    // Returns true when a new entry was added, false when an existing one was overwritten.
+    template <typename KK, typename VV>
+    bool insert_or_assign(KK&& key, VV&& value, size_t hash) {
+        auto [v, inserted] = try_emplace(std::forward<KK>(key), hash, std::forward<VV>(value));
+        if (!inserted) {
+            *v = std::forward<VV>(value);
+        }
+        return inserted;
+    }
+
+    // Constructs the value from `args` only if `key` is absent. Returns the
+    // entry's value and whether it was inserted.
+    template <typename KK, typename... Args>
+    std::pair<V*, bool> try_emplace(KK&& key, size_t hash, Args&&... args) {
+        rehash_step(kRehashStep);
+        if (V* existing = find(key, hash)) {
+            return {existing, false};
+        }
+        auto& bucket = bucket_for(rehashing() ? 1 : 0, hash);
+        bucket.emplace_back(hash, std::forward<KK>(key), std::forward<Args>(args)...);
+        ++count;
+        // Starting a resize only allocates the new array; no entry moves yet.
+        maybe_resize();
+        return {&bucket.back().second, true};
+    }
+
+    template <typename Q>
+    bool erase(const Q& key, size_t hash) {
+        rehash_step(kRehashStep);
+        for (int t = 0; t < (rehashing() ? 2 : 1); ++t) {
+            auto& bucket = bucket_for(t, hash);
+            for (auto it = bucket.begin(); it != bucket.end(); ++it) {
+                if (it->hash == hash && eq(it->first, key)) {
+                    if (&*it != &bucket.back()) {
+                        *it = std::move(bucket.back());
+                    }
+                    bucket.pop_back();
+                    --count;
+                    maybe_resize();
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    // Erases every entry for which pred(key, value) is true; returns how many.
+    template <typename Pred>
+    size_t erase_if(Pred&& pred) {
+        size_t erased = 0;
+        for (int t = 0; t < (rehashing() ? 2 : 1); ++t) {
+            for (Bucket& bucket : tables[t]) {
+                for (size_t i = 0; i < bucket.size();) {
+                    if (pred(static_cast<const K&>(bucket[i].first), bucket[i].second)) {
+                        if (i + 1 != bucket.size()) {
+                            bucket[i] = std::move(bucket.back());
+                        }
+                        bucket.pop_back();
+                        ++erased;
+                    } else {
+                        ++i;
+                    }
+                }
+            }
+        }
+        count -= erased;
+        maybe_resize();
+        return erased;
+    }
+
+    // Pulls the bucket header and its first entries towards the cache ahead of a find.
+    void prefetch(size_t hash) const {
+        const Bucket& bucket = bucket_for(rehashing() ? 1 : 0, hash);
+        __builtin_prefetch(&bucket);
+        __builtin_prefetch(bucket.data());
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    size_t bucket_count() const {
+        return rehashing() ? tables[1].size() : tables[0].size();
+    }
+
+    // Finishes any rehash, resizes the bucket array to the smallest one that
+    // holds the current entries, and trims every chain's spare capacity.
+    void shrink_to_fit() {
+        finish_rehash();
+        size_t target = kMinBuckets;
+        while (target * kMaxLoadFactor < count) {
+            target *= 2;
+        }
+        if (target < tables[0].size()) {
+            tables[1].resize(target);
+            finish_rehash();
+        }
+        for (Bucket& bucket : tables[0]) {
+            bucket.shrink_to_fit();
+        }
+    }
+
+    // Calls fn(key, value) for every entry, in no particular order.
+    template <typename Fn>
+    void for_each(Fn&& fn) const {
+        for (int t = 0; t < (rehashing() ? 2 : 1); ++t) {
+            for (const Bucket& bucket : tables[t]) {
+                for (const Node& node : bucket) {
+                    fn(node.first, node.second);
+                }
+            }
+        }
+    }
+
+    // Walks every bucket; meant for occasional stats snapshots.
+    ChainStats chain_stats() const {
+        ChainStats stats;
+        for (int t = 0; t < (rehashing() ? 2 : 1); ++t) {
+            for (const Bucket& bucket : tables[t]) {
+                if (!bucket.empty()) {
+                    ++stats.chains;
+                    stats.total += bucket.size();
+                    stats.longest = std::max(stats.longest, bucket.size());
+                }
+            }
+        }
+        return stats;
+    }
+
+    bool rehashing() const {
+        return !tables[1].empty();
+    }
+
+    // Migrates up to `steps` non-empty buckets from the old array to the new one.
+    void rehash_step(size_t steps) {
+        if (!rehashing()) {
+            return;
+        }
+        auto& from = tables[0];
+        size_t empty_visits = steps * 10;
+        while (steps > 0 && rehash_idx < from.size()) {
+            auto& bucket = from[rehash_idx];
+            if (bucket.empty()) {
+                ++rehash_idx;
+                if (--empty_visits == 0) {
+                    break;
+                }
+                continue;
+            }
+            for (auto& entry : bucket) {
+                bucket_for(1, entry.hash).push_back(std::move(entry));
+            }
+            bucket.clear();
+            bucket.shrink_to_fit();
+            ++rehash_idx;
+            --steps;
+        }
+        if (rehash_idx == from.size()) {
+            tables[0].swap(tables[1]);
+            tables[1].clear();
+            tables[1].shrink_to_fit();
+            rehash_idx = 0;
+        }
+    }
+
+private:
+    static size_t index_for(size_t hash, size_t buckets) {
+        // Fibonacci hashing on the high bits keeps the bucket choice independent
+        // of the low bits HashMap already used to pick the shard.
+        unsigned shift = 64 - __builtin_ctzll(buckets);
+        return static_cast<size_t>((static_cast<uint64_t>(hash) * 0x9E3779B97F4A7C15ull) >> shift);
+    }
+
+    Bucket& bucket_for(int t, size_t hash) {
+        return tables[t][index_for(hash, tables[t].size())];
+    }
+
+    const Bucket& bucket_for(int t, size_t hash) const {
+        return tables[t][index_for(hash, tables[t].size())];
+    }
+
+    void finish_rehash() {
+        while (rehashing()) {
+            rehash_step(tables[0].size());
+        }
+    }
+
+    void maybe_resize() {
+        if (rehashing()) {
+            return;
+        }
+        size_t buckets = tables[0].size();
+        if (count > buckets * kMaxLoadFactor) {
+            tables[1].resize(buckets * 2);
+        } else if (buckets > kMinBuckets && count < buckets * kMinLoadFactor) {
+            tables[1].resize(buckets / 2);
+        }
+    }
+
+    KeyEqual eq;
+    BucketArray tables[2];
+    size_t rehash_idx = 0;
+    size_t count = 0;
+};
@@ -0,0 +1,349 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "hashmap/snapshot.h"
+#include "locks/rw_lock.h"
+
+// Kind of mutation a change record describes.
+enum class ChangeOp : uint8_t {
+    Insert = 1,  // new key
+    Update = 2,  // existing key got a new value
+    Erase = 3,   // delete_k / erase_if
+    Expire = 4,  // an expired entry was removed (reap_expired, erase_if)
+};
+
+// One decoded record, as handed to ChangeRing::drain. Erase and Expire
+// records carry no value.
+template <typename K, typename V>
+struct ChangeEvent {
+    ChangeOp op;
+    K key;
+    std::optional<V> value;
+    uint64_t ttl_ns;  // remaining lifetime when published, 0 = never expires
+};
+
+struct ChangeFeedStats {
+    uint64_t dropped = 0;
+    size_t pending_bytes = 0;
+    size_t capacity = 0;
+};
+
+// True when Serializer<T> is defined, i.e. T can travel through a ChangeRing.
+template <typename T, typename = void>
+struct is_serializable : std::false_type {};
+
+template <typename T>
+struct is_serializable<T, std::void_t<decltype(sizeof(Serializer<T>))>> : std::true_type {};
+
+// Bounded multi-producer, single-consumer byte ring carrying HashMap change
+// records (see HashMap::set_change_feed). Producers claim space with one CAS
+// on the head position, copy the record in and publish it by storing its
+// length word last; the consumer drains committed records in order and hands
+// the space back by zeroing it and advancing the tail. Records are 8-byte
+// aligned and never wrap: one that does not fit before the end of the buffer
+// is preceded by a padding record.
+//
+// When the ring is full, Overflow::Drop discards the record and bumps a
+// counter the consumer can watch to resynchronize (e.g. from a snapshot);
+// Overflow::Block makes the producer wait for space, which slows writers of
+// the affected shard down to the consumer's pace.
+//
+// The ring lives on the heap, or in a file mapped MAP_SHARED so that a
+// consumer in another process can open the same path and drain it. The file
+// layout is host-endian and meant for processes on the same machine.
+class ChangeRing {
+public:
+    enum class Overflow { Drop, Block };
+
+    static constexpr size_t kMinCapacity = 4096;
+
+    // Heap-backed ring of at least `capacity` bytes (rounded up to a power of two).
+    explicit ChangeRing(size_t capacity, Overflow overflow = Overflow::Drop) : overflow(overflow) {
+        size_t bytes = sizeof(Control) + round_capacity(capacity);
+        heap.reset(new (std::align_val_t(kCacheLineSize)) char[bytes]);
+        init(heap.get(), round_capacity(capacity));
+    }
+
+    // Ring in the file at `path`, created with `capacity` bytes if it is
+    // missing or empty, otherwise attached with the capacity it was created
+    // with. Throws std::runtime_error if the file cannot be mapped or is not
+    // a change ring.
+    ChangeRing(const std::string& path, size_t capacity, Overflow overflow = Overflow::Drop) : overflow(overflow) {
+#if defined(__unix__) || defined(__APPLE__)
+        int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd < 0) {
+            throw std::runtime_error("change feed: cannot open " + path);
+        }
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            ::close(fd);
+            throw std::runtime_error("change feed: cannot stat " + path);
+        }
+        bool create = st.st_size == 0;
+        size_t data_bytes = round_capacity(capacity);
+        if (create) {
+            if (::ftruncate(fd, static_cast<off_t>(sizeof(Control) + data_bytes)) != 0) {
+                ::close(fd);
+                throw std::runtime_error("change feed: cannot size " + path);
+            }
+            mapped_bytes = sizeof(Control) + data_bytes;
+        } else {
+            mapped_bytes = static_cast<size_t>(st.st_size);
+        }
+        if (mapped_bytes < sizeof(Control)) {
+            ::close(fd);
+            throw std::runtime_error("change feed: bad header in " + path);
+        }
+        void* p = ::mmap(nullptr, mapped_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) {
+            throw std::runtime_error("change feed: cannot map " + path);
+        }
+        mapped = p;
+        if (create) {
+            init(static_cast<char*>(p), data_bytes);
+        } else {
+            attach(static_cast<char*>(p));
+            size_t found = control->capacity;
+            if (found < kMinCapacity || (found & (found - 1)) != 0 || sizeof(Control) + found != mapped_bytes) {
+                unmap();
+                throw std::runtime_error("change feed: bad header in " + path);
+            }
+        }
+#else
+        (void)path;
+        (void)capacity;
+        throw std::runtime_error("change feed: shared rings need mmap");
+#endif
+    }
+
+    ChangeRing(const ChangeRing&) = delete;
+    ChangeRing& operator=(const ChangeRing&) = delete;
+
+    ~ChangeRing() {
+        unmap();
+    }
+
+    // Appends one record; returns false if it was dropped. Callable from any
+    // number of threads at once.
+    template <typename K, typename V>
+    bool publish(ChangeOp op, const K& key, const V* value, uint64_t ttl_ns) {
+        size_t key_bytes = Serializer<K>::size(key);
+        size_t value_bytes = value ? Serializer<V>::size(*value) : 0;
+        size_t bytes = align_up(sizeof(RecordHeader) + key_bytes + value_bytes);
+        if (bytes > capacity / 2 || key_bytes > UINT32_MAX || value_bytes > UINT32_MAX) {
+            control->dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        uint64_t pos = control->head.load(std::memory_order_relaxed);
+        uint64_t claimed;
+        for (;;) {
+            size_t offset = pos & (capacity - 1);
+            claimed = bytes <= capacity - offset ? bytes : capacity - offset + bytes;
+            if (pos + claimed - control->tail.load(std::memory_order_acquire) > capacity) {
+                if (overflow == Overflow::Drop) {
+                    control->dropped.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                }
+                std::this_thread::yield();
+                pos = control->head.load(std::memory_order_relaxed);
+                continue;
+            }
+            if (control->head.compare_exchange_weak(pos, pos + claimed, std::memory_order_relaxed)) {
+                break;
+            }
+        }
+
+        char* at = data + (pos & (capacity - 1));
+        if (claimed != bytes) {
+            // The tail end of the buffer is too short: pad it out and start at 0.
+            commit(at, static_cast<uint32_t>(claimed - bytes) | kPadding);
+            at = data;
+        }
+        RecordHeader rec{0, static_cast<uint8_t>(op), {}, static_cast<uint32_t>(key_bytes),
+                         static_cast<uint32_t>(value_bytes), ttl_ns};
+        // Everything but the length word, which the consumer may be polling.
+        std::memcpy(at + sizeof(rec.length), reinterpret_cast<const char*>(&rec) + sizeof(rec.length),
+                    sizeof(rec) - sizeof(rec.length));
+        Serializer<K>::write(key, at + sizeof(rec));
+        if (value) {
+            Serializer<V>::write(*value, at + sizeof(rec) + key_bytes);
+        }
+        commit(at, static_cast<uint32_t>(bytes));
+        return true;
+    }
+
+    // Decodes up to `max_records` committed records in publication order and
+    // calls fn(const ChangeEvent<K, V>&) for each; returns how many. Stops at
+    // the first record still being written. Only one thread (or process) may
+    // drain a ring. If fn throws, the records before the failing one are
+    // consumed and the failing one is delivered again next time.
+    template <typename K, typename V, typename Fn>
+    size_t drain(Fn&& fn, size_t max_records = std::numeric_limits<size_t>::max()) {
+        uint64_t start = control->tail.load(std::memory_order_relaxed);
+        uint64_t pos = start;
+        size_t drained = 0;
+        try {
+            while (drained < max_records) {
+                const char* at = data + (pos & (capacity - 1));
+                uint32_t word = __atomic_load_n(reinterpret_cast<const uint32_t*>(at), __ATOMIC_ACQUIRE);
+                if (word == 0) {
+                    break;
+                }
+                if (!(word & kPadding)) {
+                    RecordHeader rec;
+                    std::memcpy(&rec, at, sizeof(rec));
+                    const char* key = at + sizeof(rec);
+                    ChangeEvent<K, V> event{static_cast<ChangeOp>(rec.op), Serializer<K>::read(key, rec.key_bytes),
+                                            std::nullopt, rec.ttl_ns};
+                    if (rec.op == static_cast<uint8_t>(ChangeOp::Insert) ||
+                        rec.op == static_cast<uint8_t>(ChangeOp::Update)) {
+                        event.value.emplace(Serializer<V>::read(key + rec.key_bytes, rec.value_bytes));
+                    }
+                    fn(static_cast<const ChangeEvent<K, V>&>(event));
+                    ++drained;
+                }
+                pos += word & ~kPadding;
+            }
+        } catch (...) {
+            release(start, pos);
+            throw;
+        }
+        release(start, pos);
+        return drained;
+    }
+
+    // Records discarded so far because the ring was full or a record was
+    // larger than half of it.
+    uint64_t dropped() const {
+        return control->dropped.load(std::memory_order_relaxed);
+    }
+
+    ChangeFeedStats stats() const {
+        ChangeFeedStats s;
+        s.dropped = dropped();
+        s.pending_bytes = static_cast<size_t>(control->head.load(std::memory_order_relaxed) -
+                                              control->tail.load(std::memory_order_relaxed));
+        s.capacity = capacity;
+        return s;
+    }
+
+private:
+    static constexpr char kMagic[8] = {'H', 'M', 'F', 'E', 'E', 'D', '\0', '\1'};
+    static constexpr uint32_t kPadding = 1u << 31;
+
+    // Placed at the start of the buffer (or file). head, tail and dropped
+    // sit on their own cache lines: producers hit head, the consumer tail.
+    struct Control {
+        char magic[8];
+        uint64_t capacity;
+        alignas(kCacheLineSize) std::atomic<uint64_t> head;
+        alignas(kCacheLineSize) std::atomic<uint64_t> tail;
+        alignas(kCacheLineSize) std::atomic<uint64_t> dropped;
+    };
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "the ring shares its counters between processes");
+
+    // `length` (record bytes, or padding bytes | kPadding) is stored last
+    // and is 0 until then.
+    struct RecordHeader {
+        uint32_t length;
+        uint8_t op;
+        uint8_t reserved[3];
+        uint32_t key_bytes;
+        uint32_t value_bytes;
+        uint64_t ttl_ns;
+    };
+
+    static size_t align_up(size_t bytes) {
+        return (bytes + 7) & ~size_t(7);
+    }
+
+    static size_t round_capacity(size_t capacity) {
+        size_t rounded = kMinCapacity;
+        while (rounded < capacity) {
+            rounded *= 2;
+        }
+        return rounded;
+    }
+
+    static void commit(char* at, uint32_t length) {
+        __atomic_store_n(reinterpret_cast<uint32_t*>(at), length, __ATOMIC_RELEASE);
+    }
+
+    void init(char* base, size_t data_bytes) {
+        control = new (base) Control{};
+        control->capacity = data_bytes;
+        data = base + sizeof(Control);
+        capacity = data_bytes;
+        std::memset(data, 0, data_bytes);
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(control->magic, kMagic, sizeof(kMagic));
+    }
+
+    void attach(char* base) {
+        control = reinterpret_cast<Control*>(base);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (std::memcmp(control->magic, kMagic, sizeof(kMagic)) != 0) {
+            unmap();
+            throw std::runtime_error("change feed: not a change ring");
+        }
+        data = base + sizeof(Control);
+        capacity = control->capacity;
+    }
+
+    // Zeroes [from, to) so that the next records written there read as
+    // uncommitted, then hands the space back to the producers.
+    void release(uint64_t from, uint64_t to) {
+        if (from == to) {
+            return;
+        }
+        size_t offset = from & (capacity - 1);
+        size_t bytes = static_cast<size_t>(to - from);
+        size_t first = std::min(bytes, capacity - offset);
+        std::memset(data + offset, 0, first);
+        std::memset(data, 0, bytes - first);
+        control->tail.store(to, std::memory_order_release);
+    }
+
+    void unmap() {
+#if defined(__unix__) || defined(__APPLE__)
+        if (mapped) {
+            ::munmap(mapped, mapped_bytes);
+            mapped = nullptr;
+        }
+#endif
+    }
+
+    struct AlignedDelete {
+        void operator()(char* p) const {
+            ::operator delete[](p, std::align_val_t(kCacheLineSize));
+        }
+    };
+
+    Overflow overflow;
+    std::unique_ptr<char[], AlignedDelete> heap;
+    void* mapped = nullptr;
+    size_t mapped_bytes = 0;
+    Control* control = nullptr;
+    char* data = nullptr;
+    size_t capacity = 0;
+};
@@ -0,0 +1,59 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+
+// Background thread that calls Map::reap_expired every `interval`, so expired
+// HashMap entries are freed even if nobody looks them up again. Each pass
+// holds a shard's write lock for at most `batch` timer firings at a time.
+template <typename Map>
+class ExpiryReaper {
+public:
+    explicit ExpiryReaper(Map& map, std::chrono::milliseconds interval = std::chrono::milliseconds(100),
+                          size_t batch = Map::kReapBatch)
+        : map(map), interval(interval), batch(batch), worker([this]() { run(); }) {}
+
+    ExpiryReaper(const ExpiryReaper&) = delete;
+    ExpiryReaper& operator=(const ExpiryReaper&) = delete;
+
+    ~ExpiryReaper() {
+        stop();
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            stopping = true;
+        }
+        wakeup.notify_all();
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+
+    size_t reaped() const {
+        return total_reaped.load(std::memory_order_relaxed);
+    }
+
+private:
+    void run() {
+        std::unique_lock<std::mutex> guard(mutex);
+        while (!wakeup.wait_for(guard, interval, [this]() { return stopping; })) {
+            guard.unlock();
+            total_reaped.fetch_add(map.reap_expired(batch), std::memory_order_relaxed);
+            guard.lock();
+        }
+    }
+
+    Map& map;
+    std::chrono::milliseconds interval;
+    size_t batch;
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    bool stopping = false;
+    std::atomic<size_t> total_reaped{0};
+    std::thread worker;
+};
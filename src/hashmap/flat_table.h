@@ -0,0 +1,409 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <new>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "hashmap/stats.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Swiss-table style open-addressing storage for a single HashMap shard.
+// Entries live inline in one flat slot array next to a control array holding
+// one byte per slot: empty, deleted, or the top 7 bits of the key's hash.
+// Probing inspects a whole 16-slot group of control bytes at once (SSE2 when
+// available, scalar otherwise), so a lookup usually touches one control line
+// and one slot before comparing a key.
+//
+// Rehashing is done in one go, but only ever for one shard, so the pause is
+// bounded by the shard's size rather than the whole map.
+//
+// With trivially copyable keys and values the table also supports optimistic
+// reads that race with the writer and are validated by the caller's SeqLock.
+// To keep such reads memory-safe, arrays replaced by growth are retired rather
+// than freed until the table is destroyed (at most the size of the live array,
+// since growth doubles), the table never shrinks, and tombstones are purged in
+// place.
+//
+// Control bytes, slots and array headers are all taken from Allocator.
+template <typename K, typename V, typename Hash, typename KeyEqual = std::equal_to<K>,
+          typename Allocator = std::allocator<std::pair<const K, V>>>
+class FlatTable {
+public:
+    using Entry = std::pair<K, V>;
+
+    static constexpr size_t kGroupWidth = 16;
+    static constexpr size_t kMinCapacity = kGroupWidth;
+    static constexpr bool kOptimisticReads =
+        std::is_trivially_copyable_v<K> && std::is_trivially_copyable_v<V>;
+
+    explicit FlatTable(const Allocator& alloc = Allocator()) : alloc(alloc) {
+        arr.store(make_array(kMinCapacity), std::memory_order_relaxed);
+    }
+
+    FlatTable(const FlatTable&) = delete;
+    FlatTable& operator=(const FlatTable&) = delete;
+
+    ~FlatTable() {
+        destroy(arr.load(std::memory_order_relaxed));
+        for (Array* old : retired) {
+            free_array(old);
+        }
+    }
+
+    // `key` may be any type KeyEqual can compare against K (heterogeneous lookup).
+    template <typename Q>
+    V* find(const Q& key, size_t hash) {
+        return const_cast<V*>(static_cast<const FlatTable*>(this)->find(key, hash));
+    }
+
+    template <typename Q>
+    const V* find(const Q& key, size_t hash) const {
+        const Array* a = arr.load(std::memory_order_relaxed);
+        size_t idx = find_index(a, key, hash);
+        return idx == kNotFound ? nullptr : &a->slots[idx].second;
+    }
+
+    // Unlocked lookup for kOptimisticReads tables. The result may be torn and
+    // is only meaningful once the caller has validated it; callers run it in
+    // a SeqLock::SpeculativeReads scope, since its loads race with the writer.
+    template <typename Q>
+    std::optional<V> find_optimistic(const Q& key, size_t hash) const {
+        static_assert(kOptimisticReads, "optimistic reads need trivially copyable K and V");
+        const Array* a = arr.load(std::memory_order_acquire);
+        size_t idx = find_index(a, key, hash);
+        if (idx == kNotFound) {
+            return std::nullopt;
+        }
+        return a->slots[idx].second;
+    }
+
+    // Returns true when a new entry was added, false when an existing one was overwritten.
+    template <typename KK, typename VV>
+    bool insert_or_assign(KK&& key, VV&& value, size_t hash) {
+        auto [v, inserted] = try_emplace(std::forward<KK>(key), hash, std::forward<VV>(value));
+        if (!inserted) {
+            *v = std::forward<VV>(value);
+        }
+        return inserted;
+    }
+
+    // Constructs the value from `args` only if `key` is absent. Returns the
+    // entry's value and whether it was inserted.
+    template <typename KK, typename... Args>
+    std::pair<V*, bool> try_emplace(KK&& key, size_t hash, Args&&... args) {
+        Array* a = arr.load(std::memory_order_relaxed);
+        size_t idx = find_index(a, key, hash);
+        if (idx != kNotFound) {
+            return {&a->slots[idx].second, false};
+        }
+        if (count + tombstones + 1 > max_load(a->capacity)) {
+            // Plenty of tombstones means a same-size rehash is enough to reclaim room.
+            rehash(count + 1 > max_load(a->capacity) / 2 ? a->capacity * 2 : a->capacity);
+            a = arr.load(std::memory_order_relaxed);
+        }
+        idx = find_insert_slot(a, hash);
+        if (a->ctrl[idx] == kDeleted) {
+            --tombstones;
+        }
+        new (&a->slots[idx]) Entry(std::piecewise_construct, std::forward_as_tuple(std::forward<KK>(key)),
+                                   std::forward_as_tuple(std::forward<Args>(args)...));
+        a->ctrl[idx] = h2(hash);
+        ++count;
+        return {&a->slots[idx].second, true};
+    }
+
+    template <typename Q>
+    bool erase(const Q& key, size_t hash) {
+        Array* a = arr.load(std::memory_order_relaxed);
+        size_t idx = find_index(a, key, hash);
+        if (idx == kNotFound) {
+            return false;
+        }
+        a->slots[idx].~Entry();
+        a->ctrl[idx] = kDeleted;
+        ++tombstones;
+        --count;
+        if (!kOptimisticReads && a->capacity > kMinCapacity && count < a->capacity / 8) {
+            rehash(a->capacity / 2);
+        }
+        return true;
+    }
+
+    // Erases every entry for which pred(key, value) is true; returns how many.
+    template <typename Pred>
+    size_t erase_if(Pred&& pred) {
+        Array* a = arr.load(std::memory_order_relaxed);
+        size_t erased = 0;
+        for (size_t i = 0; i < a->capacity; ++i) {
+            if (a->ctrl[i] >= 0 && pred(static_cast<const K&>(a->slots[i].first), a->slots[i].second)) {
+                a->slots[i].~Entry();
+                a->ctrl[i] = kDeleted;
+                ++erased;
+            }
+        }
+        tombstones += erased;
+        count -= erased;
+        if (!kOptimisticReads) {
+            size_t capacity = a->capacity;
+            while (capacity > kMinCapacity && count < capacity / 8) {
+                capacity /= 2;
+            }
+            if (capacity != a->capacity) {
+                rehash(capacity);
+            }
+        }
+        return erased;
+    }
+
+    // Pulls the first probed control group and its slots towards the cache ahead of a find.
+    void prefetch(size_t hash) const {
+        const Array* a = arr.load(std::memory_order_relaxed);
+        size_t g = first_group(a, hash);
+        __builtin_prefetch(a->ctrl + g * kGroupWidth);
+        __builtin_prefetch(a->slots + g * kGroupWidth);
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    size_t bucket_count() const {
+        return arr.load(std::memory_order_relaxed)->capacity;
+    }
+
+    // Rehashes into the smallest capacity that holds the current entries
+    // (without changing capacity for optimistic tables), dropping tombstones.
+    void shrink_to_fit() {
+        const Array* a = arr.load(std::memory_order_relaxed);
+        size_t target = a->capacity;
+        if (!kOptimisticReads) {
+            target = kMinCapacity;
+            while (count > max_load(target)) {
+                target *= 2;
+            }
+        }
+        if (target != a->capacity || tombstones > 0) {
+            rehash(target);
+        }
+    }
+
+    // Calls fn(key, value) for every entry, in no particular order.
+    template <typename Fn>
+    void for_each(Fn&& fn) const {
+        const Array* a = arr.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < a->capacity; ++i) {
+            if (a->ctrl[i] >= 0) {
+                fn(a->slots[i].first, a->slots[i].second);
+            }
+        }
+    }
+
+    // Probe length, in groups, of every live entry; meant for occasional stats snapshots.
+    ChainStats chain_stats() const {
+        ChainStats stats;
+        const Array* a = arr.load(std::memory_order_relaxed);
+        size_t groups = a->capacity / kGroupWidth;
+        for (size_t i = 0; i < a->capacity; ++i) {
+            if (a->ctrl[i] < 0) {
+                continue;
+            }
+            size_t g = first_group(a, hasher(a->slots[i].first));
+            size_t length = 1;
+            for (size_t step = 1; g != i / kGroupWidth; ++step, ++length) {
+                g = (g + step) & (groups - 1);
+            }
+            ++stats.chains;
+            stats.total += length;
+            stats.longest = std::max(stats.longest, length);
+        }
+        return stats;
+    }
+
+private:
+    struct Array {
+        size_t capacity;
+        int8_t* ctrl;
+        Entry* slots;
+    };
+
+    static constexpr int8_t kEmpty = -128;
+    static constexpr int8_t kDeleted = -2;
+    static constexpr size_t kNotFound = static_cast<size_t>(-1);
+
+    static uint64_t mix(size_t hash) {
+        return static_cast<uint64_t>(hash) * 0x9E3779B97F4A7C15ull;
+    }
+
+    static int8_t h2(size_t hash) {
+        return static_cast<int8_t>(mix(hash) >> 57);
+    }
+
+    static size_t first_group(const Array* a, size_t hash) {
+        uint64_t m = mix(hash);
+        return static_cast<size_t>(m ^ (m >> 32)) & (a->capacity / kGroupWidth - 1);
+    }
+
+    static size_t max_load(size_t capacity) {
+        return capacity - capacity / 8;
+    }
+
+    // Bitmask of the slots in group `g` whose control byte equals `tag`.
+    static uint32_t match(const Array* a, size_t g, int8_t tag) {
+        const int8_t* group = a->ctrl + g * kGroupWidth;
+#if defined(__SSE2__)
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(tag))));
+#else
+        uint32_t mask = 0;
+        for (size_t i = 0; i < kGroupWidth; ++i) {
+            mask |= static_cast<uint32_t>(group[i] == tag) << i;
+        }
+        return mask;
+#endif
+    }
+
+    // Bitmask of the slots in group `g` that are empty or deleted.
+    static uint32_t match_free(const Array* a, size_t g) {
+        const int8_t* group = a->ctrl + g * kGroupWidth;
+#if defined(__SSE2__)
+        // Full slots hold a non-negative tag; both free markers have the sign bit set.
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+        return static_cast<uint32_t>(_mm_movemask_epi8(bytes));
+#else
+        uint32_t mask = 0;
+        for (size_t i = 0; i < kGroupWidth; ++i) {
+            mask |= static_cast<uint32_t>(group[i] < 0) << i;
+        }
+        return mask;
+#endif
+    }
+
+    template <typename Q>
+    static size_t find_index(const Array* a, const Q& key, size_t hash) {
+        size_t groups = a->capacity / kGroupWidth;
+        size_t g = first_group(a, hash);
+        int8_t tag = h2(hash);
+        for (size_t step = 1; step <= groups; ++step) {
+            for (uint32_t m = match(a, g, tag); m != 0; m &= m - 1) {
+                size_t idx = g * kGroupWidth + __builtin_ctz(m);
+                if (KeyEqual()(a->slots[idx].first, key)) {
+                    return idx;
+                }
+            }
+            if (match(a, g, kEmpty) != 0) {
+                return kNotFound;
+            }
+            g = (g + step) & (groups - 1);
+        }
+        return kNotFound;
+    }
+
+    static size_t find_insert_slot(const Array* a, size_t hash) {
+        size_t groups = a->capacity / kGroupWidth;
+        size_t g = first_group(a, hash);
+        for (size_t step = 1;; ++step) {
+            if (uint32_t m = match_free(a, g)) {
+                return g * kGroupWidth + __builtin_ctz(m);
+            }
+            g = (g + step) & (groups - 1);
+        }
+    }
+
+    using ArrayAlloc = typename std::allocator_traits<Allocator>::template rebind_alloc<Array>;
+    using CtrlAlloc = typename std::allocator_traits<Allocator>::template rebind_alloc<int8_t>;
+    using EntryAlloc = typename std::allocator_traits<Allocator>::template rebind_alloc<Entry>;
+
+    Array* make_array(size_t capacity) {
+        ArrayAlloc array_alloc(alloc);
+        Array* a = std::allocator_traits<ArrayAlloc>::allocate(array_alloc, 1);
+        CtrlAlloc ctrl_alloc(alloc);
+        EntryAlloc entry_alloc(alloc);
+        new (a) Array{capacity, std::allocator_traits<CtrlAlloc>::allocate(ctrl_alloc, capacity),
+                      std::allocator_traits<EntryAlloc>::allocate(entry_alloc, capacity)};
+        std::memset(a->ctrl, kEmpty, capacity);
+        return a;
+    }
+
+    void free_array(Array* a) {
+        EntryAlloc entry_alloc(alloc);
+        std::allocator_traits<EntryAlloc>::deallocate(entry_alloc, a->slots, a->capacity);
+        CtrlAlloc ctrl_alloc(alloc);
+        std::allocator_traits<CtrlAlloc>::deallocate(ctrl_alloc, a->ctrl, a->capacity);
+        ArrayAlloc array_alloc(alloc);
+        std::allocator_traits<ArrayAlloc>::deallocate(array_alloc, a, 1);
+    }
+
+    void destroy(Array* a) {
+        for (size_t i = 0; i < a->capacity; ++i) {
+            if (a->ctrl[i] >= 0) {
+                a->slots[i].~Entry();
+            }
+        }
+        free_array(a);
+    }
+
+    // Moves every live entry of `from` into `to`, leaving `from` without entries.
+    void transfer(Array* from, Array* to) {
+        for (size_t i = 0; i < from->capacity; ++i) {
+            if (from->ctrl[i] >= 0) {
+                size_t hash = hasher(from->slots[i].first);
+                size_t idx = find_insert_slot(to, hash);
+                new (&to->slots[idx]) Entry(std::move(from->slots[i]));
+                to->ctrl[idx] = h2(hash);
+                from->slots[i].~Entry();
+            }
+        }
+    }
+
+    void rehash(size_t new_capacity) {
+        Array* old = arr.load(std::memory_order_relaxed);
+        tombstones = 0;
+        if (kOptimisticReads && new_capacity == old->capacity) {
+            // Purge tombstones without swapping arrays; concurrent optimistic
+            // readers may see garbage here but never freed memory.
+            std::vector<Entry> live;
+            live.reserve(count);
+            for (size_t i = 0; i < old->capacity; ++i) {
+                if (old->ctrl[i] >= 0) {
+                    live.push_back(old->slots[i]);
+                }
+            }
+            std::memset(old->ctrl, kEmpty, old->capacity);
+            for (const Entry& entry : live) {
+                size_t hash = hasher(entry.first);
+                size_t idx = find_insert_slot(old, hash);
+                new (&old->slots[idx]) Entry(entry);
+                old->ctrl[idx] = h2(hash);
+            }
+            return;
+        }
+
+        Array* fresh = make_array(new_capacity);
+        transfer(old, fresh);
+        arr.store(fresh, std::memory_order_release);
+        if (kOptimisticReads) {
+            retired.push_back(old);
+        } else {
+            free_array(old);
+        }
+    }
+
+    Hash hasher;
+    Allocator alloc;
+    std::atomic<Array*> arr{nullptr};
+    std::vector<Array*> retired;
+    size_t count = 0;
+    size_t tombstones = 0;
+};
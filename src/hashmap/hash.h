@@ -0,0 +1,174 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+// Default hasher for HashMap and BoundedCache: wyhash (final v4) for byte
+// strings and its 64x64->128 multiply-fold mixer for integers. Unlike
+// std::hash, which is the identity for integers in libstdc++, every output
+// bit depends on every input bit, so shard and bucket selection can take any
+// slice of the hash.
+// The integer path is constexpr, so keys known at compile time hash there.
+
+namespace hash_detail {
+
+inline constexpr uint64_t kSecret[4] = {0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull, 0x4b33a62ed433d4a3ull,
+                                        0x4d5a2da51de1aa47ull};
+
+// 64x64 -> 128 bit multiply; lo/hi halves are returned in a/b.
+constexpr void mum(uint64_t& a, uint64_t& b) {
+#if defined(__SIZEOF_INT128__)
+    __uint128_t r = static_cast<__uint128_t>(a) * b;
+    a = static_cast<uint64_t>(r);
+    b = static_cast<uint64_t>(r >> 64);
+#else
+    uint64_t ha = a >> 32, hb = b >> 32, la = static_cast<uint32_t>(a), lb = static_cast<uint32_t>(b);
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb, t = rl + (rm0 << 32);
+    uint64_t c = t < rl;
+    uint64_t lo = t + (rm1 << 32);
+    c += lo < t;
+    a = lo;
+    b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+inline uint64_t read8(const uint8_t* p) {
+    uint64_t v;
+    std::memcpy(&v, p, 8);
+    return v;
+}
+
+inline uint64_t read4(const uint8_t* p) {
+    uint32_t v;
+    std::memcpy(&v, p, 4);
+    return v;
+}
+
+inline uint64_t read3(const uint8_t* p, size_t k) {
+    return (uint64_t(p[0]) << 16) | (uint64_t(p[k >> 1]) << 8) | p[k - 1];
+}
+
+}  // namespace hash_detail
+
+// Folds the 128-bit product of a and b into 64 bits.
+constexpr uint64_t hash_mix(uint64_t a, uint64_t b) {
+    hash_detail::mum(a, b);
+    return a ^ b;
+}
+
+constexpr uint64_t hash_int(uint64_t v) {
+    using hash_detail::kSecret;
+    uint64_t a = v ^ kSecret[0];
+    uint64_t b = v ^ kSecret[1];
+    hash_detail::mum(a, b);
+    return hash_mix(a ^ kSecret[0], b ^ kSecret[1]);
+}
+
+inline uint64_t hash_bytes(const void* data, size_t len, uint64_t seed = 0) {
+    using namespace hash_detail;
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    seed ^= hash_mix(seed ^ kSecret[0], kSecret[1]);
+    uint64_t a, b;
+    if (len <= 16) {
+        if (len >= 4) {
+            a = (read4(p) << 32) | read4(p + ((len >> 3) << 2));
+            b = (read4(p + len - 4) << 32) | read4(p + len - 4 - ((len >> 3) << 2));
+        } else if (len > 0) {
+            a = read3(p, len);
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        size_t i = len;
+        if (i > 48) {
+            uint64_t see1 = seed, see2 = seed;
+            do {
+                seed = hash_mix(read8(p) ^ kSecret[1], read8(p + 8) ^ seed);
+                see1 = hash_mix(read8(p + 16) ^ kSecret[2], read8(p + 24) ^ see1);
+                see2 = hash_mix(read8(p + 32) ^ kSecret[3], read8(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            seed ^= see1 ^ see2;
+        }
+        while (i > 16) {
+            seed = hash_mix(read8(p) ^ kSecret[1], read8(p + 8) ^ seed);
+            i -= 16;
+            p += 16;
+        }
+        a = read8(p + i - 16);
+        b = read8(p + i - 8);
+    }
+    a ^= kSecret[1];
+    b ^= seed;
+    mum(a, b);
+    return hash_mix(a ^ kSecret[0] ^ len, b ^ kSecret[1]);
+}
+
+// Integers, enums and pointers go through hash_int, strings through
+// hash_bytes; anything else is hashed with std::hash and then mixed, so a
+// weak user hash still spreads across shards.
+template <typename T, typename Enable = void>
+struct DefaultHash {
+    size_t operator()(const T& value) const {
+        return static_cast<size_t>(hash_int(static_cast<uint64_t>(std::hash<T>()(value))));
+    }
+};
+
+template <typename T>
+struct DefaultHash<T, std::enable_if_t<std::is_integral_v<T> || std::is_enum_v<T> || std::is_pointer_v<T>>> {
+    constexpr size_t operator()(T value) const {
+        if constexpr (std::is_pointer_v<T>) {
+            return static_cast<size_t>(hash_int(reinterpret_cast<uintptr_t>(value)));
+        } else {
+            return static_cast<size_t>(hash_int(static_cast<uint64_t>(value)));
+        }
+    }
+};
+
+template <typename T>
+struct DefaultHash<T, std::enable_if_t<std::is_floating_point_v<T>>> {
+    size_t operator()(T value) const {
+        if (value == T(0)) {
+            value = T(0);  // +0.0 and -0.0 compare equal
+        }
+        uint64_t bits = 0;
+        std::memcpy(&bits, &value, sizeof(T) < sizeof(bits) ? sizeof(T) : sizeof(bits));
+        return static_cast<size_t>(hash_int(bits));
+    }
+};
+
+// Transparent, so maps that also use std::equal_to<> can be probed with
+// std::string_view or string literals.
+template <>
+struct DefaultHash<std::string> {
+    using is_transparent = void;
+
+    size_t operator()(std::string_view s) const {
+        return static_cast<size_t>(hash_bytes(s.data(), s.size()));
+    }
+};
+
+template <>
+struct DefaultHash<std::string_view> : DefaultHash<std::string> {};
+
+// Maps a hash onto [0, N) without dividing. Table engines take bucket indices
+// from the top bits of the hash, so a power-of-two N masks the low bits;
+// otherwise the hash is re-mixed with one multiply and range-reduced with a
+// multiply-shift (fastrange), which keeps weak hashes such as std::hash<int>
+// spread.
+template <int N>
+inline size_t reduce_hash(size_t hash) {
+    static_assert(N > 0, "reduce_hash needs a non-empty range");
+    if constexpr ((N & (N - 1)) == 0) {
+        return hash & (N - 1);
+    } else {
+        uint32_t low = static_cast<uint32_t>((static_cast<uint64_t>(hash) * 0xC2B2AE3D27D4EB4Full) >> 32);
+        return static_cast<size_t>((static_cast<uint64_t>(low) * N) >> 32);
+    }
+}
@@ -1,17 +1,51 @@
 #pragma once
 #include <string>
+#include <tuple>
+#include <utility>
 
+#include "hashmap/hash.h"
+
+// Builds one hash out of several fields. Each field is hashed with
+// DefaultHash and folded in with a 128-bit multiply, so the result depends on
+// field order and every bit of every field.
 class HashCombiner {
 public:
     size_t hash_value = 0;
     
     template<typename T>
     void combine(const T& value) {
-        std::hash<T> hasher;
-        hash_value ^= hasher(value) + 0x9e3779b9 + (hash_value << 6) + (hash_value >> 2);
+        DefaultHash<T> hasher;
+        hash_value = static_cast<size_t>(hash_mix(hash_value ^ hash_detail::kSecret[0],
+                                                  static_cast<uint64_t>(hasher(value)) ^ hash_detail::kSecret[1]));
     }
     
     operator size_t() const {
         return hash_value;
     }
-};
\ No newline at end of file
+};
+
+// Tuples and pairs hash field by field through HashCombiner, so composite keys
+// need no hasher of their own. Transparent: a tuple of references (e.g. from
+// std::forward_as_tuple) hashes like the tuple of values it refers to.
+template <typename... T>
+struct DefaultHash<std::tuple<T...>> {
+    using is_transparent = void;
+
+    template <typename... U>
+    size_t operator()(const std::tuple<U...>& fields) const {
+        static_assert(sizeof...(U) == sizeof...(T), "tuple arity must match the key");
+        HashCombiner combiner;
+        std::apply([&](const auto&... field) { (combiner.combine(field), ...); }, fields);
+        return combiner;
+    }
+};
+
+template <typename A, typename B>
+struct DefaultHash<std::pair<A, B>> {
+    size_t operator()(const std::pair<A, B>& fields) const {
+        HashCombiner combiner;
+        combiner.combine(fields.first);
+        combiner.combine(fields.second);
+        return combiner;
+    }
+};
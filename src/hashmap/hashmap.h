@@ -1,77 +1,1173 @@
 #pragma once
 #include <vector>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 #include <functional>
 #include <optional>
 #include <algorithm>
+#include <chrono>
+#include <exception>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
 
+#include "hashmap/chained_table.h"
+#include "hashmap/change_feed.h"
+#include "hashmap/flat_table.h"
+#include "hashmap/hash.h"
+#include "hashmap/hot_tier.h"
+#include "hashmap/inline_table.h"
+#include "hashmap/slab_allocator.h"
+#include "hashmap/snapshot.h"
+#include "hashmap/stats.h"
+#include "hashmap/timer_wheel.h"
 #include "locks/rw_lock.h"
+#include "locks/seq_lock.h"
 
-template <typename K, typename V, int SZ = 1000, typename Hash = std::hash<K>>
+// SZ is the number of lock shards. Each shard owns a Table that grows and
+// shrinks on its own, so the bucket count follows the number of keys while the
+// number of locks stays fixed. Table selects the storage engine: ChainedTable
+// (separate chaining, incremental rehash), FlatTable (Swiss-table style open
+// addressing with SIMD tag probing) or InlineTable (linear probing over
+// parallel key/value arrays for integral keys and trivially copyable values).
+// The default, DefaultTable, picks InlineTable where it applies and
+// ChainedTable otherwise. The default hasher is DefaultHash
+// (wyhash); shard selection never divides (see reduce_hash).
+//
+// When the engine supports it (FlatTable with trivially copyable K and V),
+// lookup_k first tries an optimistic read validated by the shard's SeqLock and
+// only takes the shard's read lock if a writer got in the way.
+//
+// Entries may carry a TTL. Expired entries are invisible to lookups right
+// away and are physically removed by reap_expired (see ExpiryReaper), driven
+// by a per-shard TimerWheel.
+//
+// save_snapshot / load_snapshot dump the map to a binary file and rebuild it
+// from an mmap of that file, for keys and values with a Serializer. The same
+// types can stream every mutation into a ChangeRing (set_change_feed).
+//
+// enable_hot_tier copies the most looked-up keys into a small HotTier that
+// readers reach without touching the shard lock; writes to those keys go
+// through to the tier under the shard's write lock.
+//
+// When both Hash and KeyEqual declare `is_transparent`, lookup_k, visit and
+// delete_k also accept keys of other types (e.g. std::string_view against
+// std::string keys) without building a K.
+//
+// Fairness is the shard lock policy (see BasicRWLock); ReaderPreference or
+// PhaseFair trade writer latency for flatter reader tail latency.
+template <typename K, typename V, int SZ = 1000, typename Hash = DefaultHash<K>,
+          typename KeyEqual = std::equal_to<K>,
+          template <typename, typename, typename, typename, typename> class Table = DefaultTable,
+          typename Allocator = std::allocator<std::pair<const K, V>>, typename Fairness = WriterPreference>
 class HashMap {
+    static_assert(SZ > 0, "HashMap needs at least one shard");
+
+private:
+    // What the engine stores per key: the value plus its expiry deadline on
+    // the steady clock in nanoseconds (0 = never expires).
+    struct Slot {
+        template <typename... Args>
+        explicit Slot(uint64_t expires_at, Args&&... args)
+            : value(std::forward<Args>(args)...), expires_at(expires_at) {}
+
+        V value;
+        uint64_t expires_at;
+    };
+
+    using EngineAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<std::pair<const K, Slot>>;
+    using Engine = Table<K, Slot, Hash, KeyEqual, EngineAllocator>;
+
+    // Allocators that can be bound to a SlabArena get one arena per shard.
+    static constexpr bool kShardArena = std::is_constructible_v<EngineAllocator, SlabArena*>;
+    struct NoArena {};
+    using Arena = std::conditional_t<kShardArena, SlabArena, NoArena>;
+
+    template <typename T, typename = void>
+    struct is_transparent : std::false_type {};
+    template <typename T>
+    struct is_transparent<T, std::void_t<typename T::is_transparent>> : std::true_type {};
+
 public:
-    size_t hash_fn(const K& key) {
-        return hasher(key) % SZ;
-    }
+    static constexpr bool kHeterogeneous = is_transparent<Hash>::value && is_transparent<KeyEqual>::value;
+
+    template <typename Q>
+    using EnableHeterogeneous = std::enable_if_t<kHeterogeneous && !std::is_same_v<std::decay_t<Q>, K>, int>;
 
-    HashMap() {
-        hash_map.resize(SZ);
-        rwlocks.resize(SZ);
+    static constexpr bool kOptimisticReads = Engine::kOptimisticReads;
+    static constexpr bool kChangeFeed = is_serializable<K>::value && is_serializable<V>::value;
+    static constexpr bool kHotTier = std::is_copy_constructible_v<K> && std::is_copy_constructible_v<V>;
+    using HotTierT = HotTier<K, V, Hash, KeyEqual>;
+    // Values fetch_add / compare_exchange may update under the read lock.
+    static constexpr bool kAtomicValues =
+        (std::is_arithmetic_v<V> || std::is_enum_v<V> || std::is_pointer_v<V>) && sizeof(V) <= sizeof(uint64_t);
+    static constexpr int kOptimisticAttempts = 4;
+    static constexpr size_t kReapBatch = 256;
+    static constexpr size_t kPrefetchDistance = 4;
+
+    size_t hash_fn(const K& key) const {
+        return hasher(key);
     }
+
+    HashMap() : shards(SZ) {}
+
     void insert_kv(const K& key, const V& value) {
         size_t hash_val = hash_fn(key);
-        RWLock& curr_lock = rwlocks[hash_val];
-        
-        curr_lock.write([this, &key, &value]() {
-            size_t hash_val = hash_fn(key);
-            auto& bucket = hash_map[hash_val];
-            bool found = false;
-            for (auto& [k, v] : bucket) {
-                if (k == key) {
-                    v = value;
-                    found = true;
-                    break;
+        insert_in(shard_for(hash_val), key, value, hash_val, 0);
+    }
+
+    // Moves key and value into the map instead of copying them.
+    void insert_kv(K&& key, V&& value) {
+        size_t hash_val = hash_fn(key);
+        insert_in(shard_for(hash_val), std::move(key), std::move(value), hash_val, 0);
+    }
+
+    // Constructs the value in place from `args` if `key` is absent (or has
+    // expired); leaves an existing entry untouched. Returns true if inserted.
+    template <typename... Args>
+    bool try_emplace(const K& key, Args&&... args) {
+        return try_emplace_in(key, std::forward<Args>(args)...);
+    }
+
+    template <typename... Args>
+    bool try_emplace(K&& key, Args&&... args) {
+        return try_emplace_in(std::move(key), std::forward<Args>(args)...);
+    }
+
+    // Inserts or overwrites `key`; the entry expires `ttl` from now.
+    void insert_kv(const K& key, const V& value, std::chrono::nanoseconds ttl) {
+        size_t hash_val = hash_fn(key);
+        insert_in(shard_for(hash_val), key, value, hash_val, deadline_after(ttl));
+    }
+
+    std::optional<V> lookup_k(const K& key) {
+        size_t hash_val = hash_fn(key);
+        Shard& shard = shard_for(hash_val);
+        if constexpr (kHotTier) {
+            if (HotTierT* tier = hot_tier.load(std::memory_order_acquire)) {
+                bool promote = tier->sample(hash_val);
+                if (std::optional<V> value = tier->lookup(key, hash_val)) {
+                    return value;
+                }
+                if (promote) {
+                    return promote_in(shard, *tier, key, hash_val);
                 }
             }
-            if (!found) {
-                hash_map[hash_val].emplace_back(key, value);
+        }
+        return lookup_in(shard, key, hash_val);
+    }
+
+    template <typename Q, EnableHeterogeneous<Q> = 0>
+    std::optional<V> lookup_k(const Q& key) {
+        size_t hash_val = hasher(key);
+        return lookup_in(shard_for(hash_val), key, hash_val);
+    }
+
+    // Calls fn(const V&) on the value under the shard's read lock, so callers
+    // can read parts of a large value without copying it. Returns false (and
+    // does not call fn) if the key is absent. fn must not call back into the map.
+    template <typename Fn>
+    bool visit(const K& key, Fn&& fn) {
+        return visit_in(key, hash_fn(key), std::forward<Fn>(fn));
+    }
+
+    template <typename Q, typename Fn, EnableHeterogeneous<Q> = 0>
+    bool visit(const Q& key, Fn&& fn) {
+        return visit_in(key, hasher(key), std::forward<Fn>(fn));
+    }
+
+    // Returns the cached value for `key`, or computes it with `fn(key)` and
+    // caches the result. Concurrent callers missing on the same key share one
+    // computation: the first becomes the leader, the rest wait on its future.
+    // No lock is held while `fn` runs. If `fn` throws, every waiter receives
+    // the exception and nothing is cached. A positive `ttl` makes the cached
+    // result expire.
+    //
+    // Hits are served like lookup_k, optimistically or under the shared read
+    // lock. Only a miss takes the upgradable lock (held by one thread per
+    // shard at a time) to re-check the table and find or register the
+    // leader; only a new leader upgrades to exclusive.
+    template <typename Fn>
+    V get_or_compute(const K& key, Fn&& fn, std::chrono::nanoseconds ttl = std::chrono::nanoseconds::zero()) {
+        size_t hash_val = hash_fn(key);
+        Shard& shard = shard_for(hash_val);
+        if (std::optional<V> value = lookup_in(shard, key, hash_val)) {
+            return std::move(*value);
+        }
+
+        std::promise<V> promise;
+        std::shared_future<V> pending;
+        bool leader = false;
+        std::optional<V> hit = shard.lock.upgradable([&](auto& upgrade) -> std::optional<V> {
+            // Writers stay out while we hold the upgradable lock, so neither
+            // the table nor `inflight` can change before the upgrade. The
+            // key may have been stored since the miss above.
+            const Slot* slot = shard.table.find(key, hash_val);
+            if (slot && live(*slot)) {
+                return load_value(slot->value);
+            }
+            auto it = shard.inflight.find(key);
+            if (it != shard.inflight.end()) {
+                pending = it->second;
+                return std::nullopt;
             }
+            upgrade.write([&]() {
+                pending = promise.get_future().share();
+                shard.inflight.emplace(key, pending);
+            });
+            leader = true;
+            return std::nullopt;
         });
+        if (hit) {
+            return std::move(*hit);
+        }
+        if (!leader) {
+            return pending.get();
+        }
+
+        try {
+            V value = std::invoke(std::forward<Fn>(fn), key);
+            uint64_t expires_at = ttl > std::chrono::nanoseconds::zero() ? deadline_after(ttl) : 0;
+            shard.lock.write([&]() {
+                store(shard, key, value, hash_val, expires_at);
+                shard.inflight.erase(key);
+            });
+            promise.set_value(value);
+            return value;
+        } catch (...) {
+            shard.lock.write([&]() { shard.inflight.erase(key); });
+            promise.set_exception(std::current_exception());
+            throw;
+        }
     }
 
-    std::optional<V> lookup_k(const K& key) {
+    // Updates `key` in place under a single acquisition of the shard's write
+    // lock: calls fn(V&) on the value if the key is present, otherwise inserts
+    // `init` without calling fn. Returns true if `init` was inserted.
+    template <typename Fn>
+    bool upsert(const K& key, const V& init, Fn&& fn) {
         size_t hash_val = hash_fn(key);
-        RWLock& curr_lock = rwlocks[hash_val];
-        return curr_lock.read([this, &key]() -> std::optional<V> {
-            size_t hash_val = hash_fn(key);
-            for (const auto& [k, v] : hash_map[hash_val]) {
-                if (k == key) {
-                    return v;
-                }
+        Shard& shard = shard_for(hash_val);
+        return shard.lock.write([&]() {
+            if (Slot* slot = shard.table.find(key, hash_val); slot && live(*slot)) {
+                shard.begin_mutation();
+                std::invoke(std::forward<Fn>(fn), slot->value);
+                shard.end_mutation();
+                on_change(shard, ChangeOp::Update, key, &slot->value, slot->expires_at);
+                return false;
             }
-            return std::nullopt;
+            store(shard, key, init, hash_val, 0);
+            return true;
         });
     }
 
+    // Calls fn(V&) on the value under the shard's write lock if `key` is
+    // present; returns whether it was.
+    template <typename Fn>
+    bool compute_if_present(const K& key, Fn&& fn) {
+        size_t hash_val = hash_fn(key);
+        Shard& shard = shard_for(hash_val);
+        return shard.lock.write([&]() {
+            Slot* slot = shard.table.find(key, hash_val);
+            if (!slot || !live(*slot)) {
+                return false;
+            }
+            shard.begin_mutation();
+            std::invoke(std::forward<Fn>(fn), slot->value);
+            shard.end_mutation();
+            on_change(shard, ChangeOp::Update, key, &slot->value, slot->expires_at);
+            return true;
+        });
+    }
+
+    // For arithmetic V: adds `delta` to the value of `key` and returns the
+    // previous value. An existing entry is updated with an atomic add under
+    // the shard's read lock, so concurrent increments of hot keys do not
+    // serialize on the write lock; a missing key is inserted with `delta`
+    // under the write lock (returning V()). visit and for_each callbacks,
+    // which see values by reference, may watch such updates land. With a
+    // change feed attached, or once `key`'s shard holds hot keys, updates
+    // take the write lock so that their records come out in the order the
+    // values changed and the hot tier sees every one.
+    V fetch_add(const K& key, V delta) {
+        static_assert(kAtomicValues && !std::is_same_v<V, bool> && std::is_arithmetic_v<V>,
+                      "fetch_add needs an arithmetic value type");
+        size_t hash_val = hash_fn(key);
+        Shard& shard = shard_for(hash_val);
+        std::optional<V> prev = shard.lock.read([&]() -> std::optional<V> {
+            Slot* slot = shard.table.find(key, hash_val);
+            if (!slot || !live(*slot) || observed(shard)) {
+                return std::nullopt;
+            }
+            return atomic_add(slot->value, delta);
+        });
+        if (prev) {
+            return *prev;
+        }
+        return shard.lock.write([&]() -> V {
+            if (Slot* slot = shard.table.find(key, hash_val); slot && live(*slot)) {
+                V old = atomic_add(slot->value, delta);
+                on_change(shard, ChangeOp::Update, key, &slot->value, slot->expires_at);
+                return old;
+            }
+            store(shard, key, delta, hash_val, 0);
+            return V();
+        });
+    }
+
+    // For scalar V: if `key` is present and its value equals `expected`,
+    // replaces it with `desired` and returns true; otherwise stores the
+    // current value in `expected` and returns false. Runs under the shard's
+    // read lock (the write lock with a change feed attached or hot keys in
+    // the shard). A missing key
+    // leaves `expected` alone and returns false.
+    bool compare_exchange(const K& key, V& expected, V desired) {
+        static_assert(kAtomicValues, "compare_exchange needs an arithmetic, enum or pointer value type");
+        size_t hash_val = hash_fn(key);
+        Shard& shard = shard_for(hash_val);
+        auto exchange = [&](Slot* slot) {
+            return __atomic_compare_exchange(&slot->value, &expected, &desired, false, __ATOMIC_ACQ_REL,
+                                             __ATOMIC_ACQUIRE);
+        };
+        std::optional<bool> swapped = shard.lock.read([&]() -> std::optional<bool> {
+            Slot* slot = shard.table.find(key, hash_val);
+            if (!slot || !live(*slot)) {
+                return false;
+            }
+            if (observed(shard)) {
+                return std::nullopt;
+            }
+            return exchange(slot);
+        });
+        if (swapped) {
+            return *swapped;
+        }
+        return shard.lock.write([&]() {
+            Slot* slot = shard.table.find(key, hash_val);
+            if (!slot || !live(*slot) || !exchange(slot)) {
+                return false;
+            }
+            on_change(shard, ChangeOp::Update, key, &slot->value, slot->expires_at);
+            return true;
+        });
+    }
+
+    // Streams every later insert, update and removal into `ring` (nullptr
+    // detaches it); see ChangeRing. Each record is appended under the
+    // shard's write lock, so records for one key arrive in the order the
+    // changes were made. The ring must outlive the attachment. Needs a
+    // Serializer for K and V.
+    void set_change_feed(ChangeRing* ring) {
+        static_assert(kChangeFeed, "change feeds need a Serializer for K and V");
+        for (auto& shard : shards) {
+            shard.lock.write([&shard, ring]() { shard.feed = ring; });
+        }
+    }
+
+    // Starts tracking which keys lookup_k(const K&) sees most and serving
+    // up to `capacity` of them from a HotTier (see there). A key is promoted
+    // once its sampled count reaches `threshold`; later writes to it update
+    // the tier and deletes drop it. Lookups through visit, heterogeneous
+    // keys or async_lookup_k bypass the tier. Returns false if the tier was
+    // already enabled.
+    bool enable_hot_tier(size_t capacity = 64, uint8_t threshold = HotTierT::kDefaultThreshold) {
+        static_assert(kHotTier, "the hot tier copies keys and values");
+        std::lock_guard<std::mutex> guard(hot_tier_mutex);
+        if (hot_tier_owner) {
+            return false;
+        }
+        hot_tier_owner = std::make_unique<HotTierT>(capacity, threshold);
+        for (auto& shard : shards) {
+            shard.lock.write([&]() { shard.hot = hot_tier_owner.get(); });
+        }
+        hot_tier.store(hot_tier_owner.get(), std::memory_order_release);
+        return true;
+    }
+
+    // The keys currently in the hot tier (none if it is not enabled).
+    std::vector<K> hot_keys() const {
+        HotTierT* tier = hot_tier.load(std::memory_order_acquire);
+        return tier ? tier->keys() : std::vector<K>();
+    }
+
+    HotTierStats hot_tier_stats() const {
+        HotTierT* tier = hot_tier.load(std::memory_order_acquire);
+        return tier ? tier->stats() : HotTierStats();
+    }
+
     bool delete_k(const K& key) {
+        return delete_in(key, hash_fn(key));
+    }
+
+    template <typename Q, EnableHeterogeneous<Q> = 0>
+    bool delete_k(const Q& key) {
+        return delete_in(key, hasher(key));
+    }
+
+#if HASHMAP_HAS_COROUTINES
+    // Awaitable insert_kv / lookup_k / delete_k for coroutine callers (C++20):
+    //
+    //     std::optional<V> v = co_await map.async_lookup_k(key, executor);
+    //
+    // The shard lock is taken with BasicRWLock::async_read / async_write, so a
+    // contended shard suspends the coroutine instead of blocking its thread,
+    // and executor(handle) resumes it once the lock is held. Arguments are
+    // referenced, not copied, until the co_await completes. Lookups always go
+    // through the lock, even where lookup_k would read optimistically.
+    template <typename Executor = InlineExecutor>
+    auto async_insert_kv(const K& key, const V& value, Executor executor = {}) {
         size_t hash_val = hash_fn(key);
-        RWLock& curr_lock = rwlocks[hash_val];
-        return curr_lock.write([this, &key]() -> bool {
-            size_t hash_val = hash_fn(key);
-            auto& bucket = hash_map[hash_val];
-            
-            auto it = std::remove_if(bucket.begin(), bucket.end(), [&key](const std::pair<K, V>& curr) {
-                return curr.first == key;
-            });
+        Shard& shard = shard_for(hash_val);
+        return shard.lock.async_write([&shard, &key, &value, hash_val]() { store(shard, key, value, hash_val, 0); },
+                                      std::move(executor));
+    }
 
-            bool found = (it != bucket.end());
-            bucket.erase(it, bucket.end());
-            
-            return found;
+    template <typename Executor = InlineExecutor>
+    auto async_lookup_k(const K& key, Executor executor = {}) {
+        size_t hash_val = hash_fn(key);
+        Shard& shard = shard_for(hash_val);
+        return shard.lock.async_read([&shard, &key, hash_val]() { return lookup_locked(shard, key, hash_val); },
+                                     std::move(executor));
+    }
+
+    template <typename Executor = InlineExecutor>
+    auto async_delete_k(const K& key, Executor executor = {}) {
+        size_t hash_val = hash_fn(key);
+        Shard& shard = shard_for(hash_val);
+        return shard.lock.async_write([&shard, &key, hash_val]() { return delete_locked(shard, key, hash_val); },
+                                      std::move(executor));
+    }
+#endif
+
+    // Looks up `count` keys at once, writing one result per key into `out`
+    // (which must hold `count` elements). Keys are hashed up front and grouped
+    // by shard, so each shard's lock is taken once per batch, and the bucket of
+    // the key kPrefetchDistance positions ahead is prefetched while probing.
+    void multi_get(const K* keys, size_t count, std::optional<V>* out) {
+        for_each_shard_group(keys, count, [&](Shard& shard, const uint32_t* idx, size_t n, const size_t* hashes) {
+            auto probe_all = [&]() {
+                for (size_t i = 0; i < n; ++i) {
+                    if (i + kPrefetchDistance < n) {
+                        shard.table.prefetch(hashes[idx[i + kPrefetchDistance]]);
+                    }
+                    uint32_t k = idx[i];
+                    const Slot* slot = shard.table.find(keys[k], hashes[k]);
+                    out[k] = slot && live(*slot) ? std::optional<V>(load_value(slot->value)) : std::nullopt;
+                    shard.note_lookup(out[k].has_value());
+                }
+            };
+            if constexpr (kOptimisticReads) {
+                for (int attempt = 0; attempt < kOptimisticAttempts; ++attempt) {
+                    uint64_t snapshot = shard.seq.read_begin();
+                    for (size_t i = 0; i < n; ++i) {
+                        if (i + kPrefetchDistance < n) {
+                            shard.table.prefetch(hashes[idx[i + kPrefetchDistance]]);
+                        }
+                        uint32_t k = idx[i];
+                        std::optional<Slot> slot;
+                        {
+                            SeqLock::SpeculativeReads speculative;
+                            slot = shard.table.find_optimistic(keys[k], hashes[k]);
+                        }
+                        out[k] = slot && live(*slot) ? std::optional<V>(load_value(slot->value)) : std::nullopt;
+                    }
+                    if (shard.seq.read_validate(snapshot)) {
+                        for (size_t i = 0; i < n; ++i) {
+                            shard.note_lookup(out[idx[i]].has_value());
+                        }
+                        return;
+                    }
+                }
+            }
+            shard.lock.read(probe_all);
+        });
+    }
+
+    // Inserts or overwrites `count` entries, taking each shard's write lock once.
+    void multi_insert(const K* keys, const V* values, size_t count) {
+        for_each_shard_group(keys, count, [&](Shard& shard, const uint32_t* idx, size_t n, const size_t* hashes) {
+            shard.lock.write([&]() {
+                for (size_t i = 0; i < n; ++i) {
+                    if (i + kPrefetchDistance < n) {
+                        shard.table.prefetch(hashes[idx[i + kPrefetchDistance]]);
+                    }
+                    uint32_t k = idx[i];
+                    store(shard, keys[k], values[k], hashes[k], 0);
+                }
+            });
         });
     }
 
+    // Removes expired entries, taking each shard's write lock for at most
+    // `batch` timer firings at a time. Returns the number of entries removed.
+    size_t reap_expired(size_t batch = kReapBatch) {
+        size_t reaped = 0;
+        for (auto& shard : shards) {
+            bool more = true;
+            while (more) {
+                more = shard.lock.write([&shard, &reaped, batch]() -> bool {
+                    if (!shard.wheel) {
+                        return false;
+                    }
+                    uint64_t now = now_ns();
+                    shard.begin_mutation();
+                    bool remaining = shard.wheel->advance(now, batch, [&](const K& key, size_t hash_val) {
+                        // The timer may be stale: the key was deleted, overwritten or re-armed.
+                        const Slot* slot = shard.table.find(key, hash_val);
+                        if (slot && slot->expires_at != 0 && slot->expires_at <= now) {
+                            shard.table.erase(key, hash_val);
+                            on_change(shard, ChangeOp::Expire, key, nullptr, 0);
+                            ++reaped;
+                        }
+                    });
+                    shard.end_mutation();
+                    return remaining;
+                });
+            }
+        }
+        return reaped;
+    }
+
+    // Number of entries stored, including expired ones that have not been
+    // reaped yet.
+    size_t size() {
+        size_t total = 0;
+        for (auto& shard : shards) {
+            total += shard.lock.read([&shard]() { return shard.table.size(); });
+        }
+        return total;
+    }
+
+    size_t bucket_count() {
+        size_t total = 0;
+        for (auto& shard : shards) {
+            total += shard.lock.read([&shard]() { return shard.table.bucket_count(); });
+        }
+        return total;
+    }
+
+    // Writes every live entry to `path` and returns how many were written.
+    // Shards are copied one at a time under their read lock into a buffer and
+    // written out after the lock is dropped, so writers only ever wait for a
+    // single shard's serialization. The snapshot is consistent per shard, not
+    // across shards. Remaining TTLs are stored and re-applied on load. The file
+    // is written to `path`.tmp and renamed into place; I/O errors throw
+    // std::runtime_error.
+    size_t save_snapshot(const std::string& path) {
+        using namespace snapshot_detail;
+        std::string tmp = path + ".tmp";
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            throw std::runtime_error("snapshot: cannot create " + tmp);
+        }
+        Header header{};
+        std::memcpy(header.magic, kMagic, sizeof(kMagic));
+        header.version = kVersion;
+        header.blocks = SZ;
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        std::vector<Directory> directory(SZ);
+        uint64_t offset = sizeof(header);
+        std::string block;
+        for (int s = 0; s < SZ; ++s) {
+            Shard& shard = shards[s];
+            block.clear();
+            uint64_t entries = 0;
+            shard.lock.read([&]() {
+                uint64_t now = now_ns();
+                shard.table.for_each([&](const K& key, const Slot& slot) {
+                    if (slot.expires_at != 0 && slot.expires_at <= now) {
+                        return;
+                    }
+                    append_record(block, key, load_value(slot.value), slot.expires_at ? slot.expires_at - now : 0);
+                    ++entries;
+                });
+            });
+            out.write(block.data(), block.size());
+            directory[s] = Directory{offset, block.size(), entries};
+            offset += block.size();
+            header.entries += entries;
+        }
+        header.directory_offset = offset;
+        out.write(reinterpret_cast<const char*>(directory.data()), directory.size() * sizeof(Directory));
+        out.seekp(0);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.close();
+        if (!out || std::rename(tmp.c_str(), path.c_str()) != 0) {
+            std::remove(tmp.c_str());
+            throw std::runtime_error("snapshot: cannot write " + path);
+        }
+        return header.entries;
+    }
+
+    // Inserts every entry of a snapshot written by save_snapshot (by a map of
+    // any shard count), overwriting keys already present, and returns how many
+    // were loaded. The file is mmapped and its blocks are decoded and inserted
+    // by up to `threads` threads (0 = one per core); with the same SZ and
+    // hasher each block lands in a single shard, so the threads rarely meet on
+    // a lock. A malformed file throws std::runtime_error, possibly after some
+    // entries were inserted.
+    size_t load_snapshot(const std::string& path, unsigned threads = 0) {
+        using namespace snapshot_detail;
+        MappedFile file(path);
+        Header header;
+        if (file.size() < sizeof(header)) {
+            throw std::runtime_error("snapshot: truncated header in " + path);
+        }
+        std::memcpy(&header, file.data(), sizeof(header));
+        if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion ||
+            header.directory_offset > file.size() ||
+            (file.size() - header.directory_offset) / sizeof(Directory) < header.blocks) {
+            throw std::runtime_error("snapshot: bad header in " + path);
+        }
+        std::vector<Directory> directory(header.blocks);
+        std::memcpy(directory.data(), file.data() + header.directory_offset, header.blocks * sizeof(Directory));
+
+        std::atomic<size_t> loaded{0};
+        run_parallel(directory.size(), threads, [&](size_t b) { loaded += load_block(file, directory[b]); });
+        return loaded;
+    }
+
+    // Calls fn(const K&, const V&) for every live entry, one shard at a time
+    // under that shard's read lock. Entries written concurrently to shards not
+    // yet visited may or may not be seen. fn must not call back into the map.
+    template <typename Fn>
+    void for_each(Fn&& fn) {
+        for (auto& shard : shards) {
+            for_each_in(shard, fn);
+        }
+    }
+
+    // Like for_each, but spreads shards over up to `threads` threads
+    // (0 = one per core), so fn must be safe to call concurrently. An
+    // exception from fn stops that thread and is rethrown once all are done.
+    template <typename Fn>
+    void parallel_for_each(Fn&& fn, unsigned threads = 0) {
+        run_parallel(SZ, threads, [&](size_t s) { for_each_in(shards[s], fn); });
+    }
+
+    // Erases every live entry for which pred(const K&, const V&) is true,
+    // taking each shard's write lock once; already expired entries are
+    // dropped along the way. Returns the number of live entries erased.
+    template <typename Pred>
+    size_t erase_if(Pred&& pred) {
+        size_t erased = 0;
+        for (auto& shard : shards) {
+            shard.lock.write([&]() {
+                uint64_t now = now_ns();
+                shard.begin_mutation();
+                shard.table.erase_if([&](const K& key, const Slot& slot) {
+                    if (slot.expires_at != 0 && slot.expires_at <= now) {
+                        on_change(shard, ChangeOp::Expire, key, nullptr, 0);
+                        return true;
+                    }
+                    if (std::invoke(pred, key, static_cast<const V&>(slot.value))) {
+                        on_change(shard, ChangeOp::Erase, key, nullptr, 0);
+                        ++erased;
+                        return true;
+                    }
+                    return false;
+                });
+                shard.end_mutation();
+            });
+        }
+        return erased;
+    }
+
+    // Releases memory stranded by deletes: every shard, one write lock at a
+    // time, finishes any pending rehash, shrinks its table to the smallest
+    // size that holds its entries and trims chain capacity; with a
+    // SlabAllocator the shard's arena then returns fully free chunks to the
+    // system. Returns the number of arena bytes released.
+    size_t shrink_to_fit() {
+        size_t released = 0;
+        for (auto& shard : shards) {
+            shard.lock.write([&]() {
+                shard.begin_mutation();
+                shard.table.shrink_to_fit();
+                shard.end_mutation();
+                if constexpr (kShardArena) {
+                    released += shard.arena.trim();
+                }
+            });
+        }
+        return released;
+    }
+
+    // Occupancy and contention snapshot, per shard and summed. Takes each
+    // shard's read lock in turn and walks its table, so it costs O(size);
+    // hit/miss and lock counters are zero unless built with HASHMAP_ENABLE_STATS.
+    HashMapStats stats() {
+        HashMapStats total;
+        ChainStats chains;
+        total.shards.reserve(SZ);
+        for (auto& shard : shards) {
+            ShardStats s = shard.lock.read([&shard]() {
+                ShardStats s;
+                s.size = shard.table.size();
+                s.buckets = shard.table.bucket_count();
+                s.chain = shard.table.chain_stats();
+                return s;
+            });
+#if HASHMAP_ENABLE_STATS
+            s.hits = shard.hits.load(std::memory_order_relaxed);
+            s.misses = shard.misses.load(std::memory_order_relaxed);
+#endif
+            s.lock = shard.lock.stats();
+            total.size += s.size;
+            total.buckets += s.buckets;
+            total.hits += s.hits;
+            total.misses += s.misses;
+            total.lock += s.lock;
+            chains += s.chain;
+            total.shards.push_back(s);
+        }
+        total.load_factor = total.buckets ? double(total.size) / total.buckets : 0;
+        total.max_chain = chains.longest;
+        total.mean_chain = chains.chains ? double(chains.total) / chains.chains : 0;
+        return total;
+    }
+
 private:
+    // Aligned so that neighbouring shards never share a cache line.
+    struct alignas(kCacheLineSize) Shard {
+        Shard() : table(make_allocator(arena)) {}
+
+        static EngineAllocator make_allocator(Arena& arena) {
+            if constexpr (kShardArena) {
+                return EngineAllocator(&arena);
+            } else {
+                (void)arena;
+                return EngineAllocator();
+            }
+        }
+
+        BasicRWLock<Fairness> lock;
+        SeqLock seq;
+        // Declared before `table`, which allocates from it; guarded by `lock`.
+        Arena arena;
+        Engine table;
+        // Allocated on the first TTL insert; guarded by `lock`.
+        std::unique_ptr<TimerWheel<K>> wheel;
+        // Keys whose get_or_compute leader is still running; guarded by `lock`.
+        std::unordered_map<K, std::shared_future<V>, Hash, KeyEqual> inflight;
+        // Set by set_change_feed; guarded by `lock`.
+        ChangeRing* feed = nullptr;
+        // Set by enable_hot_tier; guarded by `lock`. `hot_keys` counts this
+        // shard's keys in the tier: while it is 0 writers skip the tier.
+        HotTierT* hot = nullptr;
+        std::atomic<uint32_t> hot_keys{0};
+#if HASHMAP_ENABLE_STATS
+        std::atomic<uint64_t> hits{0};
+        std::atomic<uint64_t> misses{0};
+#endif
+
+        void note_lookup(bool hit) {
+#if HASHMAP_ENABLE_STATS
+            (hit ? hits : misses).fetch_add(1, std::memory_order_relaxed);
+#else
+            (void)hit;
+#endif
+        }
+
+        void begin_mutation() {
+            if constexpr (kOptimisticReads) {
+                seq.write_begin();
+            }
+        }
+
+        void end_mutation() {
+            if constexpr (kOptimisticReads) {
+                seq.write_end();
+            }
+        }
+    };
+
+    Shard& shard_for(size_t hash_val) {
+        return shards[shard_index(hash_val)];
+    }
+
+    static size_t shard_index(size_t hash_val) {
+        return reduce_hash<SZ>(hash_val);
+    }
+
+    static uint64_t now_ns() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static uint64_t deadline_after(std::chrono::nanoseconds ttl) {
+        return now_ns() + std::max<int64_t>(ttl.count(), 0);
+    }
+
+    static bool live(const Slot& slot) {
+        return slot.expires_at == 0 || slot.expires_at > now_ns();
+    }
+
+    // Copies a value out under a read lock. Scalar values may be changing
+    // under fetch_add / compare_exchange at the same time, so they are read
+    // atomically (a plain load on common targets).
+    static V load_value(const V& value) {
+        if constexpr (kAtomicValues) {
+            V out;
+            __atomic_load(&value, &out, __ATOMIC_RELAXED);
+            return out;
+        } else {
+            return value;
+        }
+    }
+
+    static V atomic_add(V& value, V delta) {
+        if constexpr (std::is_integral_v<V>) {
+            return __atomic_fetch_add(&value, delta, __ATOMIC_ACQ_REL);
+        } else {
+            V prev = load_value(value);
+            V next = prev + delta;
+            while (!__atomic_compare_exchange(&value, &prev, &next, true, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+                next = prev + delta;
+            }
+            return prev;
+        }
+    }
+
+    // Caller holds the shard's write lock.
+    static void arm_timer(Shard& shard, const K& key, size_t hash_val, uint64_t expires_at) {
+        if (expires_at != 0) {
+            if (!shard.wheel) {
+                shard.wheel = std::make_unique<TimerWheel<K>>(now_ns());
+            }
+            shard.wheel->schedule(key, hash_val, expires_at);
+        }
+    }
+
+    static bool feeding(const Shard& shard) {
+        if constexpr (kChangeFeed) {
+            return shard.feed != nullptr;
+        } else {
+            (void)shard;
+            return false;
+        }
+    }
+
+    // Whether writes to the shard have to be reported through on_change.
+    static bool observed(const Shard& shard) {
+        return feeding(shard) || hot(shard);
+    }
+
+    static bool hot(const Shard& shard) {
+        if constexpr (kHotTier) {
+            return shard.hot_keys.load(std::memory_order_relaxed) != 0;
+        } else {
+            (void)shard;
+            return false;
+        }
+    }
+
+    // Appends a change record if the shard has a feed and refreshes or drops
+    // `key` in the hot tier (`value` null means it is gone). Caller holds the
+    // shard's write lock.
+    static void on_change(Shard& shard, ChangeOp op, const K& key, const V* value, uint64_t expires_at) {
+        if constexpr (kHotTier) {
+            if (hot(shard)) {
+                shard.hot->apply(key, value, expires_at);
+            }
+        }
+        if constexpr (kChangeFeed) {
+            if (shard.feed) {
+                uint64_t ttl_ns = expires_at ? std::max<uint64_t>(expires_at - std::min(expires_at, now_ns()), 1) : 0;
+                shard.feed->publish(op, key, value, ttl_ns);
+            }
+        } else {
+            (void)op;
+        }
+    }
+
+    // Caller holds the shard's write lock.
+    template <typename KK, typename VV>
+    static void store(Shard& shard, KK&& key, VV&& value, size_t hash_val, uint64_t expires_at) {
+        arm_timer(shard, key, hash_val, expires_at);
+        shard.begin_mutation();
+        if constexpr (kChangeFeed || kHotTier) {
+            if (observed(shard)) {
+                // Copies, so that key and value are still there to report.
+                bool inserted = shard.table.insert_or_assign(key, Slot(expires_at, value), hash_val);
+                shard.end_mutation();
+                const V& stored = value;
+                on_change(shard, inserted ? ChangeOp::Insert : ChangeOp::Update, key, &stored, expires_at);
+                return;
+            }
+        }
+        shard.table.insert_or_assign(std::forward<KK>(key), Slot(expires_at, std::forward<VV>(value)), hash_val);
+        shard.end_mutation();
+    }
+
+    // Hashes a batch of keys and calls fn(shard, indices, n, hashes) once per
+    // shard touched, with the positions of that shard's keys in `indices`.
+    // Scratch space is per thread and reused, so steady-state batches do not
+    // allocate.
+    template <typename Fn>
+    void for_each_shard_group(const K* keys, size_t count, Fn&& fn) {
+        struct Scratch {
+            std::vector<size_t> hashes;
+            std::vector<uint32_t> order;
+            std::vector<uint32_t> starts;
+        };
+        thread_local Scratch scratch;
+        scratch.hashes.resize(count);
+        scratch.order.resize(count);
+        scratch.starts.assign(SZ + 1, 0);
+
+        for (size_t i = 0; i < count; ++i) {
+            scratch.hashes[i] = hash_fn(keys[i]);
+            ++scratch.starts[shard_index(scratch.hashes[i]) + 1];
+        }
+        for (int s = 0; s < SZ; ++s) {
+            scratch.starts[s + 1] += scratch.starts[s];
+        }
+        // Counting sort by shard; `starts` ends up holding each group's end.
+        for (size_t i = 0; i < count; ++i) {
+            scratch.order[scratch.starts[shard_index(scratch.hashes[i])]++] = static_cast<uint32_t>(i);
+        }
+        size_t begin = 0;
+        for (int s = 0; s < SZ; ++s) {
+            size_t end = scratch.starts[s];
+            if (end > begin) {
+                fn(shards[s], scratch.order.data() + begin, end - begin, scratch.hashes.data());
+            }
+            begin = end;
+        }
+    }
+
+    template <typename Fn>
+    static void for_each_in(Shard& shard, Fn& fn) {
+        shard.lock.read([&]() {
+            uint64_t now = now_ns();
+            shard.table.for_each([&](const K& key, const Slot& slot) {
+                if (slot.expires_at == 0 || slot.expires_at > now) {
+                    std::invoke(fn, key, static_cast<const V&>(slot.value));
+                }
+            });
+        });
+    }
+
+    // Runs fn(i) for every i in [0, tasks) on up to `threads` threads
+    // (0 = one per core), the calling thread included. Rethrows the first
+    // exception (by thread) once every thread has finished.
+    template <typename Fn>
+    static void run_parallel(size_t tasks, unsigned threads, Fn&& fn) {
+        if (threads == 0) {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        threads = static_cast<unsigned>(std::max<size_t>(1, std::min<size_t>(threads, tasks)));
+        std::atomic<size_t> next{0};
+        std::vector<std::exception_ptr> errors(threads);
+        auto worker = [&](unsigned id) {
+            try {
+                for (size_t i = next++; i < tasks; i = next++) {
+                    fn(i);
+                }
+            } catch (...) {
+                errors[id] = std::current_exception();
+            }
+        };
+        std::vector<std::thread> pool;
+        for (unsigned t = 1; t < threads; ++t) {
+            pool.emplace_back(worker, t);
+        }
+        worker(0);
+        for (auto& t : pool) {
+            t.join();
+        }
+        for (auto& error : errors) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+    }
+
+    size_t load_block(const snapshot_detail::MappedFile& file, const snapshot_detail::Directory& block) {
+        using snapshot_detail::RecordHeader;
+        if (block.offset > file.size() || block.bytes > file.size() - block.offset) {
+            throw std::runtime_error("snapshot: block out of range");
+        }
+        const char* p = file.data() + block.offset;
+        const char* end = p + block.bytes;
+        size_t loaded = 0;
+        while (p < end) {
+            RecordHeader rec;
+            if (size_t(end - p) < sizeof(rec)) {
+                throw std::runtime_error("snapshot: truncated record");
+            }
+            std::memcpy(&rec, p, sizeof(rec));
+            p += sizeof(rec);
+            if (size_t(end - p) < uint64_t(rec.key_bytes) + rec.value_bytes) {
+                throw std::runtime_error("snapshot: truncated record");
+            }
+            K key = Serializer<K>::read(p, rec.key_bytes);
+            V value = Serializer<V>::read(p + rec.key_bytes, rec.value_bytes);
+            p += rec.key_bytes + rec.value_bytes;
+            size_t hash_val = hash_fn(key);
+            uint64_t expires_at = rec.ttl_ns ? now_ns() + rec.ttl_ns : 0;
+            insert_in(shard_for(hash_val), std::move(key), std::move(value), hash_val, expires_at);
+            ++loaded;
+        }
+        return loaded;
+    }
+
+    template <typename KK, typename VV>
+    void insert_in(Shard& shard, KK&& key, VV&& value, size_t hash_val, uint64_t expires_at) {
+        shard.lock.write([&]() {
+            store(shard, std::forward<KK>(key), std::forward<VV>(value), hash_val, expires_at);
+        });
+    }
+
+    template <typename KK, typename... Args>
+    bool try_emplace_in(KK&& key, Args&&... args) {
+        size_t hash_val = hash_fn(key);
+        Shard& shard = shard_for(hash_val);
+        return shard.lock.write([&]() -> bool {
+            // Kept for on_change, since `key` may be moved into the table.
+            std::optional<K> fed_key;
+            if constexpr (kChangeFeed || kHotTier) {
+                if (observed(shard)) {
+                    fed_key.emplace(key);
+                }
+            }
+            shard.begin_mutation();
+            auto [slot, inserted] = shard.table.try_emplace(std::forward<KK>(key), hash_val, uint64_t(0),
+                                                            std::forward<Args>(args)...);
+            if (!inserted && !live(*slot)) {
+                *slot = Slot(0, std::forward<Args>(args)...);
+                inserted = true;
+            }
+            shard.end_mutation();
+            if (inserted && fed_key) {
+                on_change(shard, ChangeOp::Insert, *fed_key, &slot->value, 0);
+            }
+            return inserted;
+        });
+    }
+
+    template <typename Q, typename Fn>
+    bool visit_in(const Q& key, size_t hash_val, Fn&& fn) {
+        Shard& shard = shard_for(hash_val);
+        return shard.lock.read([&]() -> bool {
+            const Slot* slot = shard.table.find(key, hash_val);
+            bool hit = slot && live(*slot);
+            shard.note_lookup(hit);
+            if (!hit) {
+                return false;
+            }
+            std::invoke(std::forward<Fn>(fn), static_cast<const V&>(slot->value));
+            return true;
+        });
+    }
+
+    template <typename Q>
+    bool delete_in(const Q& key, size_t hash_val) {
+        Shard& shard = shard_for(hash_val);
+        return shard.lock.write([&shard, &key, hash_val]() { return delete_locked(shard, key, hash_val); });
+    }
+
+    // Caller holds the shard's write lock.
+    template <typename Q>
+    static bool delete_locked(Shard& shard, const Q& key, size_t hash_val) {
+        const Slot* slot = shard.table.find(key, hash_val);
+        if (!slot) {
+            return false;
+        }
+        bool was_live = live(*slot);
+        shard.begin_mutation();
+        shard.table.erase(key, hash_val);
+        shard.end_mutation();
+        if constexpr (kHotTier) {
+            if (hot(shard)) {
+                shard.hot->remove(key);
+            }
+        }
+        if constexpr (kChangeFeed) {
+            if (shard.feed) {
+                ChangeOp op = was_live ? ChangeOp::Erase : ChangeOp::Expire;
+                shard.feed->publish(op, K(key), static_cast<const V*>(nullptr), 0);
+            }
+        }
+        return was_live;
+    }
+
+    template <typename Q>
+    std::optional<V> lookup_in(Shard& shard, const Q& key, size_t hash_val) {
+        if constexpr (kOptimisticReads) {
+            std::optional<V> value;
+            if (lookup_optimistic(shard, key, hash_val, value)) {
+                return value;
+            }
+        }
+        return shard.lock.read([&shard, &key, hash_val]() { return lookup_locked(shard, key, hash_val); });
+    }
+
+    // Lock-free lookup validated by the shard's SeqLock. Returns false if
+    // writers kept getting in the way; otherwise stores the value (or
+    // nullopt for a miss) in `out`.
+    template <typename Q>
+    static bool lookup_optimistic(Shard& shard, const Q& key, size_t hash_val, std::optional<V>& out) {
+        for (int attempt = 0; attempt < kOptimisticAttempts; ++attempt) {
+            uint64_t snapshot = shard.seq.read_begin();
+            std::optional<Slot> result;
+            {
+                SeqLock::SpeculativeReads speculative;
+                result = shard.table.find_optimistic(key, hash_val);
+            }
+            if (shard.seq.read_validate(snapshot)) {
+                bool hit = result && live(*result);
+                shard.note_lookup(hit);
+                if (hit) {
+                    out.emplace(result->value);
+                }
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // A sampled lookup of a hot key: reads it under the write lock, so that
+    // no writer can slip in between the read and the copy into the tier.
+    std::optional<V> promote_in(Shard& shard, HotTierT& tier, const K& key, size_t hash_val) {
+        return shard.lock.write([&]() -> std::optional<V> {
+            const Slot* slot = shard.table.find(key, hash_val);
+            bool hit = slot && live(*slot);
+            shard.note_lookup(hit);
+            if (!hit) {
+                return std::nullopt;
+            }
+            tier.promote(key, hash_val, slot->value, slot->expires_at, shard.hot_keys);
+            return slot->value;
+        });
+    }
+
+    // Caller holds the shard's read lock.
+    template <typename Q>
+    static std::optional<V> lookup_locked(Shard& shard, const Q& key, size_t hash_val) {
+        const Slot* slot = shard.table.find(key, hash_val);
+        bool hit = slot && live(*slot);
+        shard.note_lookup(hit);
+        if (hit) {
+            return load_value(slot->value);
+        }
+        return std::nullopt;
+    }
+
     Hash hasher;
-    std::vector<std::vector<std::pair<K, V>>> hash_map;
-    std::vector<RWLock> rwlocks;
-};
\ No newline at end of file
+    std::vector<Shard> shards;
+    // Set once by enable_hot_tier.
+    std::mutex hot_tier_mutex;
+    std::unique_ptr<HotTierT> hot_tier_owner;
+    std::atomic<HotTierT*> hot_tier{nullptr};
+};
@@ -0,0 +1,312 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "locks/rw_lock.h"
+
+struct HotTierStats {
+    size_t size = 0;
+    uint64_t hits = 0;
+    uint64_t promotions = 0;
+    uint64_t demotions = 0;
+};
+
+// Read-replicated side table for the few keys that take most of a HashMap's
+// lookups (see HashMap::enable_hot_tier). Every hot key is copied into
+// kReplicas small tables, each behind its own lock on its own cache lines;
+// a reader only touches the replica of its thread's stripe, so threads
+// hammering one key no longer share the shard lock's cache line.
+//
+// Hotness comes from a count-min sketch fed by one in kSampleEvery lookups
+// per thread. A sampled key whose estimate reaches the threshold is promoted;
+// once the tier is full it replaces the member with the lowest estimate, if
+// its own is higher. The counters are halved every kResetInterval samples so
+// that keys which cool down are demoted again.
+//
+// The owning map keeps replicas coherent: promotions copy the value under the
+// shard's write lock, and every write to a promoted key (counted per shard in
+// `shard_hot`) updates the replicas in place or removes the key, under the
+// shard's write lock.
+//
+// Evicting a member to make room for a promotion runs under the promoting
+// key's shard lock only, not the evicted key's. That is safe because writers
+// never add a key to the replicas: a write-through racing the eviction either
+// lands before the key is erased from a replica (and is erased with it) or
+// finds it gone, and the shard's count drops only once every replica has
+// lost the key, so until then its writers keep the replicas current.
+template <typename K, typename V, typename Hash, typename KeyEqual>
+class HotTier {
+public:
+    static constexpr size_t kReplicas = 16;
+    static constexpr uint32_t kSampleEvery = 32;
+    static constexpr uint8_t kDefaultThreshold = 8;
+
+    explicit HotTier(size_t capacity, uint8_t threshold = kDefaultThreshold)
+        : capacity(std::max<size_t>(capacity, 1)), threshold(threshold), sketch(kRows * kWidth) {}
+
+    HotTier(const HotTier&) = delete;
+    HotTier& operator=(const HotTier&) = delete;
+
+    // The promoted value of `key`, if it is in the tier and has not expired.
+    std::optional<V> lookup(const K& key, size_t hash) {
+        if (!maybe_member(hash)) {
+            return std::nullopt;
+        }
+        Replica& replica = replicas[stripe()];
+        std::optional<V> value = replica.lock.read([&]() -> std::optional<V> {
+            auto it = replica.entries.find(key);
+            if (it == replica.entries.end() || !live(it->second)) {
+                return std::nullopt;
+            }
+            return it->second.value;
+        });
+        if (value) {
+            replica.hits.fetch_add(1, std::memory_order_relaxed);
+        }
+        return value;
+    }
+
+    // Feeds the sketch with one in kSampleEvery calls per thread; returns
+    // true when `hash` was sampled and is hot enough to be promoted. Whether
+    // it is already a member is left to promote(): the filter is too small
+    // to rule a key out, since a cold key may share a member's bit.
+    bool sample(size_t hash) {
+        thread_local uint32_t tick = 0;
+        if (++tick % kSampleEvery != 0) {
+            return false;
+        }
+        record(hash);
+        uint8_t count = estimate(hash);
+        return count >= threshold && count > floor.load(std::memory_order_relaxed);
+    }
+
+    // Copies key/value into every replica unless it is already a member.
+    // Caller holds the write lock of the key's shard, whose hot-key count is
+    // `shard_hot`. Gives up if another thread is promoting. A full tier
+    // evicts its coolest member (see the class comment).
+    void promote(const K& key, size_t hash, const V& value, uint64_t expires_at, std::atomic<uint32_t>& shard_hot) {
+        std::unique_lock<std::mutex> guard(members_mutex, std::try_to_lock);
+        if (!guard.owns_lock()) {
+            return;
+        }
+        for (const Member& m : members) {
+            if (KeyEqual()(m.key, key)) {
+                return;
+            }
+        }
+        if (members.size() >= capacity) {
+            auto victim = std::min_element(members.begin(), members.end(), [this](const Member& a, const Member& b) {
+                return estimate(a.hash) < estimate(b.hash);
+            });
+            if (estimate(victim->hash) >= estimate(hash)) {
+                return;
+            }
+            drop(victim);
+        }
+        // Counted first: from here on writers to the shard update the replicas.
+        shard_hot.fetch_add(1, std::memory_order_relaxed);
+        for (Replica& replica : replicas) {
+            replica.lock.write([&]() { replica.entries.insert_or_assign(key, Entry{value, expires_at}); });
+        }
+        members.push_back(Member{key, hash, &shard_hot});
+        rebuild_filter();
+        update_floor();
+        promotions.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Write-through for a promoted key; `value` null removes it. Caller
+    // holds the write lock of the key's shard.
+    void apply(const K& key, const V* value, uint64_t expires_at) {
+        if (!value) {
+            remove(key);
+            return;
+        }
+        for (Replica& replica : replicas) {
+            replica.lock.write([&]() {
+                auto it = replica.entries.find(key);
+                if (it != replica.entries.end()) {
+                    it->second = Entry{*value, expires_at};
+                }
+            });
+        }
+    }
+
+    // Demotes `key` (anything KeyEqual compares against K) if it is in the
+    // tier. Caller holds the write lock of the key's shard.
+    template <typename Q>
+    void remove(const Q& key) {
+        std::lock_guard<std::mutex> guard(members_mutex);
+        auto it = std::find_if(members.begin(), members.end(), [&](const Member& m) { return KeyEqual()(m.key, key); });
+        if (it != members.end()) {
+            drop(it);
+            update_floor();
+        }
+    }
+
+    std::vector<K> keys() const {
+        std::lock_guard<std::mutex> guard(members_mutex);
+        std::vector<K> out;
+        for (const Member& m : members) {
+            out.push_back(m.key);
+        }
+        return out;
+    }
+
+    HotTierStats stats() const {
+        HotTierStats s;
+        {
+            std::lock_guard<std::mutex> guard(members_mutex);
+            s.size = members.size();
+        }
+        for (const Replica& replica : replicas) {
+            s.hits += replica.hits.load(std::memory_order_relaxed);
+        }
+        s.promotions = promotions.load(std::memory_order_relaxed);
+        s.demotions = demotions.load(std::memory_order_relaxed);
+        return s;
+    }
+
+private:
+    static constexpr size_t kRows = 4;
+    static constexpr size_t kWidth = 4096;
+    static constexpr uint8_t kMaxCount = 255;
+    static constexpr uint32_t kResetInterval = 16 * kWidth;
+    static constexpr size_t kFilterBits = 1024;
+
+    struct Entry {
+        V value;
+        uint64_t expires_at;  // steady clock, ns; 0 = never
+    };
+
+    struct alignas(kCacheLineSize) Replica {
+        RWLock lock;
+        std::unordered_map<K, Entry, Hash, KeyEqual> entries;
+        std::atomic<uint64_t> hits{0};
+    };
+
+    struct Member {
+        K key;
+        size_t hash;
+        std::atomic<uint32_t>* shard_hot;
+    };
+
+    static bool live(const Entry& entry) {
+        if (entry.expires_at == 0) {
+            return true;
+        }
+        uint64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           std::chrono::steady_clock::now().time_since_epoch()).count();
+        return entry.expires_at > now;
+    }
+
+    static size_t stripe() {
+        thread_local size_t index = std::hash<std::thread::id>()(std::this_thread::get_id()) % kReplicas;
+        return index;
+    }
+
+    static size_t filter_bit(size_t hash) {
+        return static_cast<size_t>((static_cast<uint64_t>(hash) * 0x9E3779B97F4A7C15ull) >> 54);
+    }
+
+    // Cheap pre-check so that lookups of cold keys skip the replicas: false
+    // means `hash` is certainly not promoted (or is being promoted right now).
+    bool maybe_member(size_t hash) const {
+        size_t bit = filter_bit(hash);
+        return (filter[bit / 64].load(std::memory_order_relaxed) >> (bit % 64)) & 1;
+    }
+
+    // Caller holds members_mutex.
+    void rebuild_filter() {
+        uint64_t words[kFilterBits / 64] = {};
+        for (const Member& m : members) {
+            size_t bit = filter_bit(m.hash);
+            words[bit / 64] |= uint64_t(1) << (bit % 64);
+        }
+        for (size_t i = 0; i < kFilterBits / 64; ++i) {
+            filter[i].store(words[i], std::memory_order_relaxed);
+        }
+    }
+
+    // Caller holds members_mutex.
+    void update_floor() {
+        uint8_t lowest = 0;
+        if (members.size() >= capacity) {
+            lowest = kMaxCount;
+            for (const Member& m : members) {
+                lowest = std::min(lowest, estimate(m.hash));
+            }
+        }
+        floor.store(lowest, std::memory_order_relaxed);
+    }
+
+    // Removes a member from every replica, then uncounts it from its shard.
+    // Caller holds members_mutex.
+    void drop(typename std::vector<Member>::iterator it) {
+        Member m = std::move(*it);
+        if (it != members.end() - 1) {
+            *it = std::move(members.back());
+        }
+        members.pop_back();
+        rebuild_filter();
+        for (Replica& replica : replicas) {
+            replica.lock.write([&]() { replica.entries.erase(m.key); });
+        }
+        m.shard_hot->fetch_sub(1, std::memory_order_relaxed);
+        demotions.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    static size_t slot(size_t hash, size_t row) {
+        uint64_t h = (static_cast<uint64_t>(hash) + row) * 0x9E3779B97F4A7C15ull;
+        return row * kWidth + static_cast<size_t>(h >> 52);
+    }
+
+    // Relaxed, racy increments: a lost count now and then does not matter.
+    void record(size_t hash) {
+        for (size_t row = 0; row < kRows; ++row) {
+            auto& counter = sketch[slot(hash, row)];
+            uint8_t c = counter.load(std::memory_order_relaxed);
+            if (c < kMaxCount) {
+                counter.store(c + 1, std::memory_order_relaxed);
+            }
+        }
+        if (additions.fetch_add(1, std::memory_order_relaxed) + 1 == kResetInterval) {
+            additions.store(0, std::memory_order_relaxed);
+            for (auto& counter : sketch) {
+                counter.store(counter.load(std::memory_order_relaxed) / 2, std::memory_order_relaxed);
+            }
+            floor.store(floor.load(std::memory_order_relaxed) / 2, std::memory_order_relaxed);
+        }
+    }
+
+    uint8_t estimate(size_t hash) const {
+        uint8_t best = kMaxCount;
+        for (size_t row = 0; row < kRows; ++row) {
+            best = std::min(best, sketch[slot(hash, row)].load(std::memory_order_relaxed));
+        }
+        return best;
+    }
+
+    size_t capacity;
+    uint8_t threshold;
+    Replica replicas[kReplicas];
+    std::vector<std::atomic<uint8_t>> sketch;
+    std::atomic<uint32_t> additions{0};
+    // Lowest member estimate once the tier is full, else 0: a sampled key
+    // has to beat it before sample() asks for the shard's write lock.
+    std::atomic<uint8_t> floor{0};
+    std::atomic<uint64_t> filter[kFilterBits / 64] = {};
+    // Guards `members`; promotions only try_lock it.
+    mutable std::mutex members_mutex;
+    std::vector<Member> members;
+    std::atomic<uint64_t> promotions{0};
+    std::atomic<uint64_t> demotions{0};
+};
@@ -0,0 +1,326 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include "hashmap/chained_table.h"
+#include "hashmap/stats.h"
+
+// Open-addressing storage for a single HashMap shard with an integral key and
+// a trivially copyable value. Keys and values sit in two parallel arrays, so
+// probing walks a dense run of keys and touches the value array only on a
+// hit. There is no per-slot metadata: a slot is empty when its key equals
+// kEmptyKey. The one real key that equals kEmptyKey is kept aside in its own
+// slot.
+//
+// Collisions probe linearly; erase shifts the following run back over the
+// hole instead of leaving a tombstone, so lookups never skip dead slots and
+// the table needs no tombstone purges. Capacity is a power of two, doubles at
+// 3/4 load and halves below 1/8.
+//
+// Both arrays come from Allocator (rebound to K and V).
+//
+// Not thread-safe on its own; the owning shard's lock serializes writers.
+template <typename K, typename V, typename Hash, typename KeyEqual = std::equal_to<K>,
+          typename Allocator = std::allocator<std::pair<const K, V>>>
+class InlineTable {
+    static_assert(std::is_integral_v<K>, "InlineTable needs an integral key");
+    static_assert(std::is_trivially_copyable_v<V>, "InlineTable needs a trivially copyable value");
+
+public:
+    static constexpr size_t kMinCapacity = 16;
+    static constexpr K kEmptyKey = std::numeric_limits<K>::max();
+    // Erase moves entries between slots, so unlocked readers are never safe.
+    static constexpr bool kOptimisticReads = false;
+
+    explicit InlineTable(const Allocator& alloc = Allocator()) : keys_alloc(alloc), values_alloc(alloc) {
+        allocate(kMinCapacity);
+    }
+
+    InlineTable(const InlineTable&) = delete;
+    InlineTable& operator=(const InlineTable&) = delete;
+
+    ~InlineTable() {
+        deallocate();
+    }
+
+    // `key` may be any type KeyEqual can compare against K (heterogeneous lookup).
+    template <typename Q>
+    V* find(const Q& key, size_t hash) {
+        return const_cast<V*>(static_cast<const InlineTable*>(this)->find(key, hash));
+    }
+
+    template <typename Q>
+    const V* find(const Q& key, size_t hash) const {
+        if (KeyEqual()(kEmptyKey, key)) {
+            return empty_key_value ? &*empty_key_value : nullptr;
+        }
+        size_t idx = find_index(key, hash);
+        return idx == kNotFound ? nullptr : &values[idx];
+    }
+
+    // Returns true when a new entry was added, false when an existing one was overwritten.
+    template <typename KK, typename VV>
+    bool insert_or_assign(KK&& key, VV&& value, size_t hash) {
+        auto [v, inserted] = try_emplace(std::forward<KK>(key), hash, std::forward<VV>(value));
+        if (!inserted) {
+            *v = std::forward<VV>(value);
+        }
+        return inserted;
+    }
+
+    // Constructs the value from `args` only if `key` is absent. Returns the
+    // entry's value and whether it was inserted.
+    template <typename KK, typename... Args>
+    std::pair<V*, bool> try_emplace(KK&& key, size_t hash, Args&&... args) {
+        K k = static_cast<K>(key);
+        if (k == kEmptyKey) {
+            if (empty_key_value) {
+                return {&*empty_key_value, false};
+            }
+            empty_key_value.emplace(std::forward<Args>(args)...);
+            ++count;
+            return {&*empty_key_value, true};
+        }
+        size_t idx = find_index(k, hash);
+        if (idx != kNotFound) {
+            return {&values[idx], false};
+        }
+        if (slot_count() + 1 > max_load(capacity)) {
+            rehash(capacity * 2);
+        }
+        idx = find_empty(hash);
+        keys[idx] = k;
+        new (&values[idx]) V(std::forward<Args>(args)...);
+        ++count;
+        return {&values[idx], true};
+    }
+
+    template <typename Q>
+    bool erase(const Q& key, size_t hash) {
+        if (KeyEqual()(kEmptyKey, key)) {
+            if (!empty_key_value) {
+                return false;
+            }
+            empty_key_value.reset();
+            --count;
+            return true;
+        }
+        size_t idx = find_index(key, hash);
+        if (idx == kNotFound) {
+            return false;
+        }
+        remove_at(idx);
+        --count;
+        if (capacity > kMinCapacity && count < capacity / 8) {
+            rehash(capacity / 2);
+        }
+        return true;
+    }
+
+    // Erases every entry for which pred(key, value) is true; returns how many.
+    // The survivors are rehashed into a right-sized array in the same pass.
+    template <typename Pred>
+    size_t erase_if(Pred&& pred) {
+        size_t erased = 0;
+        if (empty_key_value && pred(kEmptyKey, static_cast<const V&>(*empty_key_value))) {
+            empty_key_value.reset();
+            ++erased;
+        }
+        K* old_keys = keys;
+        V* old_values = values;
+        size_t old_capacity = capacity;
+        size_t kept = 0;
+        for (size_t i = 0; i < old_capacity; ++i) {
+            if (old_keys[i] != kEmptyKey) {
+                if (pred(static_cast<const K&>(old_keys[i]), static_cast<const V&>(old_values[i]))) {
+                    old_keys[i] = kEmptyKey;
+                    ++erased;
+                } else {
+                    ++kept;
+                }
+            }
+        }
+        count -= erased;
+        if (erased > 0) {
+            rebuild(old_keys, old_values, old_capacity, fitting_capacity(kept));
+        }
+        return erased;
+    }
+
+    // Pulls the key and value at the home slot towards the cache ahead of a find.
+    void prefetch(size_t hash) const {
+        size_t idx = home(hash);
+        __builtin_prefetch(keys + idx);
+        __builtin_prefetch(values + idx);
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    size_t bucket_count() const {
+        return capacity;
+    }
+
+    // Rehashes into the smallest capacity that holds the current entries.
+    void shrink_to_fit() {
+        size_t target = fitting_capacity(slot_count());
+        if (target != capacity) {
+            rehash(target);
+        }
+    }
+
+    // Calls fn(key, value) for every entry, in no particular order.
+    template <typename Fn>
+    void for_each(Fn&& fn) const {
+        if (empty_key_value) {
+            fn(kEmptyKey, static_cast<const V&>(*empty_key_value));
+        }
+        for (size_t i = 0; i < capacity; ++i) {
+            if (keys[i] != kEmptyKey) {
+                fn(static_cast<const K&>(keys[i]), static_cast<const V&>(values[i]));
+            }
+        }
+    }
+
+    // Probe length, in slots, of every live entry; meant for occasional stats snapshots.
+    ChainStats chain_stats() const {
+        ChainStats stats;
+        if (empty_key_value) {
+            stats.chains = stats.total = stats.longest = 1;
+        }
+        for (size_t i = 0; i < capacity; ++i) {
+            if (keys[i] == kEmptyKey) {
+                continue;
+            }
+            size_t length = ((i - home(hasher(keys[i]))) & (capacity - 1)) + 1;
+            ++stats.chains;
+            stats.total += length;
+            stats.longest = std::max(stats.longest, length);
+        }
+        return stats;
+    }
+
+private:
+    static constexpr size_t kNotFound = static_cast<size_t>(-1);
+
+    using KeysAlloc = typename std::allocator_traits<Allocator>::template rebind_alloc<K>;
+    using ValuesAlloc = typename std::allocator_traits<Allocator>::template rebind_alloc<V>;
+
+    static size_t max_load(size_t capacity) {
+        return capacity - capacity / 4;
+    }
+
+    static size_t fitting_capacity(size_t entries) {
+        size_t target = kMinCapacity;
+        while (entries > max_load(target)) {
+            target *= 2;
+        }
+        return target;
+    }
+
+    // Entries stored in the arrays, i.e. without the kEmptyKey one.
+    size_t slot_count() const {
+        return count - (empty_key_value ? 1 : 0);
+    }
+
+    // Fibonacci hashing: the top bits of the product, so weak hashes such as
+    // the identity std::hash<int> still spread over the slots.
+    size_t home(size_t hash) const {
+        return static_cast<size_t>((static_cast<uint64_t>(hash) * 0x9E3779B97F4A7C15ull) >> shift);
+    }
+
+    template <typename Q>
+    size_t find_index(const Q& key, size_t hash) const {
+        for (size_t i = home(hash);; i = (i + 1) & (capacity - 1)) {
+            if (KeyEqual()(keys[i], key)) {
+                return i;
+            }
+            if (keys[i] == kEmptyKey) {
+                return kNotFound;
+            }
+        }
+    }
+
+    size_t find_empty(size_t hash) const {
+        size_t i = home(hash);
+        while (keys[i] != kEmptyKey) {
+            i = (i + 1) & (capacity - 1);
+        }
+        return i;
+    }
+
+    // Backward-shift deletion: every later entry of the run whose home slot
+    // does not lie after the hole moves into it, until the run ends.
+    void remove_at(size_t hole) {
+        size_t mask = capacity - 1;
+        for (size_t i = (hole + 1) & mask; keys[i] != kEmptyKey; i = (i + 1) & mask) {
+            size_t h = home(hasher(keys[i]));
+            if (((i - h) & mask) >= ((i - hole) & mask)) {
+                keys[hole] = keys[i];
+                new (&values[hole]) V(values[i]);
+                hole = i;
+            }
+        }
+        keys[hole] = kEmptyKey;
+    }
+
+    void allocate(size_t new_capacity) {
+        capacity = new_capacity;
+        shift = 64 - static_cast<unsigned>(__builtin_ctzll(new_capacity));
+        keys = std::allocator_traits<KeysAlloc>::allocate(keys_alloc, new_capacity);
+        values = std::allocator_traits<ValuesAlloc>::allocate(values_alloc, new_capacity);
+        std::fill_n(keys, new_capacity, kEmptyKey);
+    }
+
+    void deallocate() {
+        std::allocator_traits<KeysAlloc>::deallocate(keys_alloc, keys, capacity);
+        std::allocator_traits<ValuesAlloc>::deallocate(values_alloc, values, capacity);
+    }
+
+    // Moves the live entries of the given arrays into fresh ones of
+    // `new_capacity` slots and frees the old arrays.
+    void rebuild(K* old_keys, V* old_values, size_t old_capacity, size_t new_capacity) {
+        allocate(new_capacity);
+        for (size_t i = 0; i < old_capacity; ++i) {
+            if (old_keys[i] != kEmptyKey) {
+                size_t idx = find_empty(hasher(old_keys[i]));
+                keys[idx] = old_keys[i];
+                new (&values[idx]) V(old_values[i]);
+            }
+        }
+        std::allocator_traits<KeysAlloc>::deallocate(keys_alloc, old_keys, old_capacity);
+        std::allocator_traits<ValuesAlloc>::deallocate(values_alloc, old_values, old_capacity);
+    }
+
+    void rehash(size_t new_capacity) {
+        rebuild(keys, values, capacity, new_capacity);
+    }
+
+    Hash hasher;
+    KeysAlloc keys_alloc;
+    ValuesAlloc values_alloc;
+    K* keys = nullptr;
+    V* values = nullptr;
+    size_t capacity = 0;
+    unsigned shift = 0;
+    size_t count = 0;
+    std::optional<V> empty_key_value;
+};
+
+// Engine HashMap and LeftRightMap use when none is given: InlineTable for
+// integral keys with trivially copyable values under plain equality,
+// ChainedTable for everything else.
+template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator>
+using DefaultTable = std::conditional_t<
+    std::is_integral_v<K> && std::is_trivially_copyable_v<V> &&
+        (std::is_same_v<KeyEqual, std::equal_to<K>> || std::is_same_v<KeyEqual, std::equal_to<>>),
+    InlineTable<K, V, Hash, KeyEqual, Allocator>, ChainedTable<K, V, Hash, KeyEqual, Allocator>>;
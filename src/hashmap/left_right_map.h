@@ -0,0 +1,117 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "hashmap/chained_table.h"
+#include "hashmap/flat_table.h"
+#include "hashmap/hash.h"
+#include "hashmap/inline_table.h"
+#include "locks/left_right.h"
+
+// Read-mostly counterpart of HashMap for maps that change a few times per
+// second and are read millions of times per second. Two copies of one Table
+// are kept under LeftRight: lookups are wait-free and never stall behind a
+// writer, while every write is applied to both copies and waits for readers
+// of the old copy to drain. Memory doubles.
+//
+// Writers are serialized by a single mutex, so batch them with multi_insert
+// where possible: a batch pays for one flip instead of one per key.
+//
+// No TTLs or snapshots; Table is chosen as for HashMap.
+template <typename K, typename V, typename Hash = DefaultHash<K>, typename KeyEqual = std::equal_to<K>,
+          template <typename, typename, typename, typename, typename> class Table = DefaultTable>
+class LeftRightMap {
+    using Engine = Table<K, V, Hash, KeyEqual, std::allocator<std::pair<const K, V>>>;
+
+public:
+    size_t hash_fn(const K& key) const {
+        return hasher(key);
+    }
+
+    void insert_kv(const K& key, const V& value) {
+        size_t hash_val = hash_fn(key);
+        tables.write([&](Engine& table) { table.insert_or_assign(key, value, hash_val); });
+    }
+
+    // The first copy gets copies; key and value are moved into the second.
+    void insert_kv(K&& key, V&& value) {
+        size_t hash_val = hash_fn(key);
+        int pass = 0;
+        tables.write([&](Engine& table) {
+            if (pass++ == 0) {
+                table.insert_or_assign(static_cast<const K&>(key), static_cast<const V&>(value), hash_val);
+            } else {
+                table.insert_or_assign(std::move(key), std::move(value), hash_val);
+            }
+        });
+    }
+
+    // Inserts or overwrites `count` pairs with a single flip.
+    void multi_insert(const K* keys, const V* values, size_t count) {
+        std::vector<size_t> hashes(count);
+        for (size_t i = 0; i < count; ++i) {
+            hashes[i] = hash_fn(keys[i]);
+        }
+        tables.write([&](Engine& table) {
+            for (size_t i = 0; i < count; ++i) {
+                table.insert_or_assign(keys[i], values[i], hashes[i]);
+            }
+        });
+    }
+
+    std::optional<V> lookup_k(const K& key) const {
+        size_t hash_val = hash_fn(key);
+        return tables.read([&](const Engine& table) -> std::optional<V> {
+            if (const V* value = table.find(key, hash_val)) {
+                return *value;
+            }
+            return std::nullopt;
+        });
+    }
+
+    // Calls fn(const V&) on the value in place if `key` is present. fn runs
+    // while the reader is registered, so long callbacks delay writers.
+    template <typename Fn>
+    bool visit(const K& key, Fn&& fn) const {
+        size_t hash_val = hash_fn(key);
+        return tables.read([&](const Engine& table) -> bool {
+            const V* value = table.find(key, hash_val);
+            if (!value) {
+                return false;
+            }
+            std::invoke(std::forward<Fn>(fn), *value);
+            return true;
+        });
+    }
+
+    bool delete_k(const K& key) {
+        size_t hash_val = hash_fn(key);
+        // Skip the flip entirely when there is nothing to delete.
+        if (!tables.read([&](const Engine& table) { return table.find(key, hash_val) != nullptr; })) {
+            return false;
+        }
+        return tables.write([&](Engine& table) { return table.erase(key, hash_val); });
+    }
+
+    // Calls fn(key, value) for every entry of one consistent version.
+    template <typename Fn>
+    void for_each(Fn&& fn) const {
+        tables.read([&](const Engine& table) { table.for_each(fn); });
+    }
+
+    size_t size() const {
+        return tables.read([](const Engine& table) { return table.size(); });
+    }
+
+    size_t bucket_count() const {
+        return tables.read([](const Engine& table) { return table.bucket_count(); });
+    }
+
+private:
+    Hash hasher;
+    LeftRight<Engine> tables;
+};
@@ -0,0 +1,322 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <utility>
+
+#include "hashmap/hash.h"
+#include "locks/epoch.h"
+
+// Lock-free alternative to HashMap, offering the same insert_kv / lookup_k /
+// delete_k interface for A/B runs on large machines (see bench --target).
+//
+// The table is a split-ordered list (Shalev & Shavit): every entry lives in
+// one Harris-Michael linked list sorted by the bit-reversed hash, and each
+// bucket is a pointer to a dummy node inside that list. Doubling the bucket
+// count never moves entries; a new bucket is initialised lazily by splicing
+// its dummy in after its parent's. Bucket pointers live in segments of
+// doubling size, so the directory grows without being copied.
+//
+// Values sit behind their own pointer: insert_kv on an existing key swaps in a
+// new value, and lookup_k copies whichever value it loads. Unlinked nodes and
+// replaced values are handed to the process-wide EpochDomain and freed once no
+// pinned thread can still see them. Every operation pins the calling thread
+// for its duration and never blocks; callers must not hold references into
+// the map across calls.
+//
+// No TTLs, snapshots or stats; size() is a relaxed counter.
+template <typename K, typename V, typename Hash = DefaultHash<K>, typename KeyEqual = std::equal_to<K>>
+class LockFreeHashMap {
+public:
+    static constexpr size_t kFirstSegment = 64;
+    static constexpr size_t kSegments = 48;
+    static constexpr size_t kMaxLoadFactor = 2;
+
+    LockFreeHashMap() : buckets(kFirstSegment) {
+        Node* head = new Node(dummy_key(0));
+        bucket_slot(0).store(head, std::memory_order_release);
+    }
+
+    LockFreeHashMap(const LockFreeHashMap&) = delete;
+    LockFreeHashMap& operator=(const LockFreeHashMap&) = delete;
+
+    // Not safe against concurrent access; retired nodes already handed to
+    // the epoch domain are freed by it.
+    ~LockFreeHashMap() {
+        Node* cur = bucket_slot(0).load(std::memory_order_relaxed);
+        while (cur) {
+            Node* next = unmarked(cur->next.load(std::memory_order_relaxed));
+            if (is_regular(cur->so_key)) {
+                delete static_cast<Entry*>(cur);
+            } else {
+                delete cur;
+            }
+            cur = next;
+        }
+        for (auto& segment : segments) {
+            delete[] segment.load(std::memory_order_relaxed);
+        }
+    }
+
+    size_t hash_fn(const K& key) const {
+        return hasher(key);
+    }
+
+    void insert_kv(const K& key, const V& value) {
+        insert_in(key, value);
+    }
+
+    void insert_kv(K&& key, V&& value) {
+        insert_in(std::move(key), std::move(value));
+    }
+
+    std::optional<V> lookup_k(const K& key) {
+        EpochGuard guard;
+        size_t hash_val = hash_fn(key);
+        uint64_t so = regular_key(hash_val);
+        Node* cur = unmarked(bucket_head(hash_val).next.load(std::memory_order_acquire));
+        while (cur && cur->so_key <= so) {
+            uintptr_t next = cur->next.load(std::memory_order_acquire);
+            if (cur->so_key == so && !(next & kMark) && eq(static_cast<Entry*>(cur)->key, key)) {
+                return *static_cast<Entry*>(cur)->value.load(std::memory_order_acquire);
+            }
+            cur = unmarked(next);
+        }
+        return std::nullopt;
+    }
+
+    bool delete_k(const K& key) {
+        EpochGuard guard;
+        size_t hash_val = hash_fn(key);
+        Node& head = bucket_head(hash_val);
+        uint64_t so = regular_key(hash_val);
+        for (;;) {
+            Window w = find(head, so, &key);
+            if (!w.found) {
+                return false;
+            }
+            uintptr_t next = w.cur->next.load(std::memory_order_acquire);
+            if ((next & kMark) ||
+                !w.cur->next.compare_exchange_weak(next, next | kMark, std::memory_order_acq_rel)) {
+                continue;
+            }
+            count.fetch_sub(1, std::memory_order_relaxed);
+            // Unlink it ourselves if we can; otherwise a fresh search will.
+            uintptr_t expected = reinterpret_cast<uintptr_t>(w.cur);
+            if (w.prev->next.compare_exchange_strong(expected, next, std::memory_order_acq_rel)) {
+                EpochDomain::global().retire(static_cast<Entry*>(w.cur));
+            } else {
+                find(head, so, &key);
+            }
+            return true;
+        }
+    }
+
+    // Calls fn(key, value) for every entry present throughout the walk;
+    // entries inserted or deleted concurrently may or may not be seen.
+    template <typename Fn>
+    void for_each(Fn&& fn) {
+        EpochGuard guard;
+        Node* cur = bucket_slot(0).load(std::memory_order_acquire);
+        while (cur) {
+            uintptr_t next = cur->next.load(std::memory_order_acquire);
+            if (is_regular(cur->so_key) && !(next & kMark)) {
+                Entry* e = static_cast<Entry*>(cur);
+                fn(static_cast<const K&>(e->key), static_cast<const V&>(*e->value.load(std::memory_order_acquire)));
+            }
+            cur = unmarked(next);
+        }
+    }
+
+    size_t size() const {
+        return count.load(std::memory_order_relaxed);
+    }
+
+    size_t bucket_count() const {
+        return buckets.load(std::memory_order_relaxed);
+    }
+
+private:
+    static constexpr uintptr_t kMark = 1;
+
+    struct Node {
+        explicit Node(uint64_t so_key) : so_key(so_key) {}
+
+        // Bit-reversed hash; odd for entries, even for bucket dummies.
+        const uint64_t so_key;
+        // Successor, with kMark set once this node is logically deleted.
+        std::atomic<uintptr_t> next{0};
+    };
+
+    struct Entry : Node {
+        template <typename KK>
+        Entry(uint64_t so_key, KK&& key, V* value) : Node(so_key), key(std::forward<KK>(key)), value(value) {}
+        ~Entry() {
+            delete value.load(std::memory_order_relaxed);
+        }
+
+        const K key;
+        std::atomic<V*> value;
+    };
+
+    struct Window {
+        Node* prev;
+        Node* cur;
+        bool found;
+    };
+
+    static uint64_t reverse_bits(uint64_t v) {
+        v = ((v >> 1) & 0x5555555555555555ull) | ((v & 0x5555555555555555ull) << 1);
+        v = ((v >> 2) & 0x3333333333333333ull) | ((v & 0x3333333333333333ull) << 2);
+        v = ((v >> 4) & 0x0f0f0f0f0f0f0f0full) | ((v & 0x0f0f0f0f0f0f0f0full) << 4);
+        return __builtin_bswap64(v);
+    }
+
+    static uint64_t regular_key(size_t hash_val) {
+        return reverse_bits(static_cast<uint64_t>(hash_val) | (uint64_t(1) << 63));
+    }
+
+    static uint64_t dummy_key(size_t bucket) {
+        return reverse_bits(bucket);
+    }
+
+    static bool is_regular(uint64_t so_key) {
+        return so_key & 1;
+    }
+
+    static Node* unmarked(uintptr_t link) {
+        return reinterpret_cast<Node*>(link & ~kMark);
+    }
+
+    // Segment 0 holds buckets [0, kFirstSegment); segment s > 0 holds
+    // [kFirstSegment << (s - 1), kFirstSegment << s).
+    std::atomic<Node*>& bucket_slot(size_t bucket) {
+        size_t seg = 0;
+        size_t base = 0;
+        if (bucket >= kFirstSegment) {
+            seg = 64 - __builtin_clzll(bucket / kFirstSegment);
+            base = kFirstSegment << (seg - 1);
+        }
+        std::atomic<Node*>* segment = segments[seg].load(std::memory_order_acquire);
+        if (!segment) {
+            size_t len = seg == 0 ? kFirstSegment : base;
+            std::atomic<Node*>* fresh = new std::atomic<Node*>[len]();
+            if (segments[seg].compare_exchange_strong(segment, fresh, std::memory_order_acq_rel)) {
+                segment = fresh;
+            } else {
+                delete[] fresh;
+            }
+        }
+        return segment[bucket - base];
+    }
+
+    Node& bucket_head(size_t hash_val) {
+        size_t bucket = hash_val & (buckets.load(std::memory_order_acquire) - 1);
+        Node* head = bucket_slot(bucket).load(std::memory_order_acquire);
+        return head ? *head : init_bucket(bucket);
+    }
+
+    // Splices the dummy for `bucket` into the list after its parent's dummy
+    // (the bucket with the top bit cleared), initialising the parent first.
+    Node& init_bucket(size_t bucket) {
+        size_t parent = bucket & ~(size_t(1) << (63 - __builtin_clzll(bucket)));
+        Node* parent_head = bucket_slot(parent).load(std::memory_order_acquire);
+        Node& from = parent_head ? *parent_head : init_bucket(parent);
+
+        uint64_t so = dummy_key(bucket);
+        Node* dummy = new Node(so);
+        for (;;) {
+            Window w = find(from, so, nullptr);
+            if (w.found) {
+                delete dummy;
+                dummy = w.cur;
+                break;
+            }
+            uintptr_t expected = reinterpret_cast<uintptr_t>(w.cur);
+            dummy->next.store(expected, std::memory_order_relaxed);
+            if (w.prev->next.compare_exchange_strong(expected, reinterpret_cast<uintptr_t>(dummy),
+                                                     std::memory_order_acq_rel)) {
+                break;
+            }
+        }
+        bucket_slot(bucket).store(dummy, std::memory_order_release);
+        return *dummy;
+    }
+
+    // Harris-Michael search from `head`: returns the first node not ordered
+    // before (so, key) and its predecessor, unlinking marked nodes on the way.
+    // A null key searches for the dummy with sort key `so`.
+    Window find(Node& head, uint64_t so, const K* key) {
+    retry:
+        Node* prev = &head;
+        Node* cur = unmarked(prev->next.load(std::memory_order_acquire));
+        while (cur) {
+            uintptr_t next = cur->next.load(std::memory_order_acquire);
+            if (next & kMark) {
+                uintptr_t expected = reinterpret_cast<uintptr_t>(cur);
+                if (!prev->next.compare_exchange_strong(expected, next & ~kMark, std::memory_order_acq_rel)) {
+                    goto retry;
+                }
+                // Only entries are ever marked.
+                EpochDomain::global().retire(static_cast<Entry*>(cur));
+                cur = unmarked(next);
+                continue;
+            }
+            if (cur->so_key > so) {
+                break;
+            }
+            if (cur->so_key == so && (!key || eq(static_cast<Entry*>(cur)->key, *key))) {
+                return {prev, cur, true};
+            }
+            prev = cur;
+            cur = unmarked(next);
+        }
+        return {prev, cur, false};
+    }
+
+    template <typename KK, typename VV>
+    void insert_in(KK&& key, VV&& value) {
+        EpochGuard guard;
+        size_t hash_val = hash_fn(key);
+        Node& head = bucket_head(hash_val);
+        uint64_t so = regular_key(hash_val);
+        V* fresh = new V(std::forward<VV>(value));
+        Entry* node = nullptr;
+        for (;;) {
+            Window w = find(head, so, node ? &node->key : &key);
+            if (w.found) {
+                // If the entry is being deleted, this update is ordered
+                // before that delete and disappears with it.
+                V* old = static_cast<Entry*>(w.cur)->value.exchange(fresh, std::memory_order_acq_rel);
+                EpochDomain::global().retire(old);
+                if (node) {
+                    node->value.store(nullptr, std::memory_order_relaxed);
+                    delete node;
+                }
+                return;
+            }
+            if (!node) {
+                node = new Entry(so, std::forward<KK>(key), fresh);
+            }
+            uintptr_t expected = reinterpret_cast<uintptr_t>(w.cur);
+            node->next.store(expected, std::memory_order_relaxed);
+            if (w.prev->next.compare_exchange_strong(expected, reinterpret_cast<uintptr_t>(node),
+                                                     std::memory_order_acq_rel)) {
+                break;
+            }
+        }
+        size_t n = count.fetch_add(1, std::memory_order_relaxed) + 1;
+        size_t b = buckets.load(std::memory_order_relaxed);
+        if (n > b * kMaxLoadFactor && b < (kFirstSegment << (kSegments - 1))) {
+            buckets.compare_exchange_strong(b, b * 2, std::memory_order_acq_rel);
+        }
+    }
+
+    Hash hasher;
+    KeyEqual eq;
+    std::atomic<size_t> buckets;
+    std::atomic<size_t> count{0};
+    std::atomic<std::atomic<Node*>*> segments[kSegments] = {};
+};
@@ -0,0 +1,595 @@
+#pragma once
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Writer locks are robust process-shared mutexes, which macOS lacks.
+#if defined(__linux__) || defined(__FreeBSD__)
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define HASHMAP_HAS_SHARED_MEMORY 1
+#else
+#define HASHMAP_HAS_SHARED_MEMORY 0
+#endif
+
+#include "hashmap/hash.h"
+#include "locks/rw_lock.h"
+#include "locks/seq_lock.h"
+
+// Hash map that lives entirely in a POSIX shared-memory segment, so that
+// every process on a host that opens the same name shares one set of
+// entries. K and V must be trivially copyable, and Hash must give the same
+// result in every process (DefaultHash does).
+//
+// The segment holds SZ cache-line aligned shards, each a small header
+// followed by a fixed array of linear-probing slots. Nothing in it is a
+// pointer: shards and slots are found from the segment's base by offset,
+// so each process may map it at a different address. Capacity is fixed when
+// the segment is created; insert_kv returns false once a shard is full.
+//
+// Readers take no lock. They probe optimistically, validated by the shard's
+// SeqLock, and only after repeated interference fall back to the shard lock.
+// Writers serialize on a robust process-shared mutex per shard, so the
+// kernel itself tells the next writer when an owner died holding it, however
+// the processes' pid namespaces are set up. That writer repairs the shard
+// before going on: the slot the dead owner was changing is dropped, so a crashed
+// process costs a cache entry but never wedges a shard. The exception is an
+// owner that dies while compacting (rare: only once tombstones fill a
+// shard's load limit): the shard's entries are then all lost, and the shard
+// comes back empty.
+//
+// The layout is host-endian and tied to K, V and SZ; opening a segment
+// created with different ones throws std::runtime_error.
+template <typename K, typename V, int SZ = 64, typename Hash = DefaultHash<K>,
+          typename KeyEqual = std::equal_to<K>>
+class SharedHashMap {
+    static_assert(SZ > 0, "SharedHashMap needs at least one shard");
+    static_assert(std::is_trivially_copyable_v<K> && std::is_trivially_copyable_v<V>,
+                  "SharedHashMap stores keys and values as raw bytes");
+
+public:
+    static constexpr int kOptimisticAttempts = 4;
+    static constexpr size_t kMinShardSlots = 8;
+
+    // Opens the segment `name` (as for shm_open, e.g. "/ratios"), creating
+    // it sized for about `capacity` entries if it does not exist yet. When it
+    // does, `capacity` is ignored and the creator's layout is used.
+    SharedHashMap(const std::string& name, size_t capacity) {
+#if HASHMAP_HAS_SHARED_MEMORY
+        size_t slots = shard_slots(capacity);
+        size_t bytes = segment_bytes(slots);
+        int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+        bool create = fd >= 0;
+        if (!create) {
+            if (errno != EEXIST || (fd = ::shm_open(name.c_str(), O_RDWR, 0600)) < 0) {
+                throw std::runtime_error("shared map: cannot open " + name);
+            }
+            bytes = wait_for_size(fd);
+        } else if (::ftruncate(fd, static_cast<off_t>(bytes)) != 0) {
+            ::close(fd);
+            ::shm_unlink(name.c_str());
+            throw std::runtime_error("shared map: cannot size " + name);
+        }
+        if (bytes < sizeof(Header)) {
+            ::close(fd);
+            throw std::runtime_error("shared map: bad header in " + name);
+        }
+        void* p = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) {
+            throw std::runtime_error("shared map: cannot map " + name);
+        }
+        base = static_cast<char*>(p);
+        mapped_bytes = bytes;
+        if (create && !init(slots)) {
+            unmap();
+            ::shm_unlink(name.c_str());
+            throw std::runtime_error("shared map: cannot lay out " + name);
+        }
+        if (!create && !attach()) {
+            unmap();
+            throw std::runtime_error("shared map: bad header in " + name);
+        }
+#else
+        (void)name;
+        (void)capacity;
+        throw std::runtime_error("shared map: needs POSIX shared memory");
+#endif
+    }
+
+    SharedHashMap(const SharedHashMap&) = delete;
+    SharedHashMap& operator=(const SharedHashMap&) = delete;
+
+    // Unmaps the segment; the entries stay for the other processes.
+    ~SharedHashMap() {
+        unmap();
+    }
+
+    // Deletes the segment's name; processes that have it mapped keep using it.
+    static bool remove(const std::string& name) {
+#if HASHMAP_HAS_SHARED_MEMORY
+        return ::shm_unlink(name.c_str()) == 0;
+#else
+        (void)name;
+        return false;
+#endif
+    }
+
+    // Inserts or overwrites `key`. Returns false if the key is new and its
+    // shard has no room left.
+    bool insert_kv(const K& key, const V& value) {
+        size_t hash_val = hasher(key);
+        Shard& shard = shard_for(hash_val);
+        WriteGuard guard(*this, shard);
+        return put(shard, key, value, hash_val, true).second;
+    }
+
+    std::optional<V> lookup_k(const K& key) {
+        size_t hash_val = hasher(key);
+        Shard& shard = shard_for(hash_val);
+        for (int attempt = 0; attempt < kOptimisticAttempts; ++attempt) {
+            uint64_t snapshot = shard.seq.read_begin();
+            std::optional<V> result;
+            size_t idx = find(shard, key, hash_val);
+            if (idx != kNotFound) {
+                result = slots(shard)[idx].value;
+            }
+            if (shard.seq.read_validate(snapshot)) {
+                return result;
+            }
+        }
+        WriteGuard guard(*this, shard);
+        size_t idx = find(shard, key, hash_val);
+        return idx == kNotFound ? std::nullopt : std::optional<V>(slots(shard)[idx].value);
+    }
+
+    bool delete_k(const K& key) {
+        size_t hash_val = hasher(key);
+        Shard& shard = shard_for(hash_val);
+        WriteGuard guard(*this, shard);
+        size_t idx = find(shard, key, hash_val);
+        if (idx == kNotFound) {
+            return false;
+        }
+        begin_change(shard, idx);
+        erase_at(shard, idx);
+        end_change(shard);
+        return true;
+    }
+
+    // Returns the value of `key`, or computes it with fn(key) and stores it.
+    // No lock is held while fn runs, so processes missing on the same key at
+    // the same time may each compute it; the first one stored wins and is
+    // returned to all of them. If the shard is full the result is returned
+    // without being stored.
+    template <typename Fn>
+    V get_or_compute(const K& key, Fn&& fn) {
+        if (std::optional<V> hit = lookup_k(key)) {
+            return *hit;
+        }
+        V value = std::invoke(std::forward<Fn>(fn), key);
+        size_t hash_val = hasher(key);
+        Shard& shard = shard_for(hash_val);
+        WriteGuard guard(*this, shard);
+        auto [idx, stored] = put(shard, key, value, hash_val, false);
+        return stored || idx == kNotFound ? value : slots(shard)[idx].value;
+    }
+
+    // Calls fn(V&) on the value of `key` in place under the shard lock, or
+    // inserts `init` if the key is absent. Returns false only if the key was
+    // absent and its shard is full.
+    template <typename Fn>
+    bool upsert(const K& key, const V& init, Fn&& fn) {
+        size_t hash_val = hasher(key);
+        Shard& shard = shard_for(hash_val);
+        WriteGuard guard(*this, shard);
+        size_t idx = find(shard, key, hash_val);
+        if (idx == kNotFound) {
+            return put(shard, key, init, hash_val, true).second;
+        }
+        begin_change(shard, idx);
+        std::invoke(std::forward<Fn>(fn), slots(shard)[idx].value);
+        end_change(shard);
+        return true;
+    }
+
+    size_t size() const {
+        size_t total = 0;
+        for (int s = 0; s < SZ; ++s) {
+            total += shard_at(s).size.load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+    // Entries the segment can hold when keys spread evenly over the shards.
+    size_t capacity() const {
+        return SZ * max_load(header().slots);
+    }
+
+    // Shard repairs after a writer died holding the shard's lock.
+    uint64_t recoveries() const {
+        return header().recoveries.load(std::memory_order_relaxed);
+    }
+
+private:
+    static constexpr char kMagic[8] = {'H', 'M', 'S', 'H', 'M', 'A', 'P', '\2'};
+    static constexpr size_t kNotFound = static_cast<size_t>(-1);
+    // Shard::dirty while compact() rebuilds the slot array.
+    static constexpr uint64_t kRebuilding = UINT64_MAX;
+    static constexpr std::chrono::seconds kAttachTimeout{5};
+
+    enum : uint8_t { kEmpty = 0, kFull = 1, kTombstone = 2 };
+
+    // First bytes of the segment. `ready` is set once the creator has laid
+    // out every shard; processes attaching earlier wait for it.
+    struct Header {
+        char magic[8];
+        uint32_t shards;
+        uint32_t slot_bytes;
+        uint32_t key_bytes;
+        uint32_t value_bytes;
+        uint64_t slots;
+        uint64_t shard_bytes;
+        std::atomic<uint32_t> ready;
+        std::atomic<uint64_t> recoveries;
+    };
+
+    struct alignas(kCacheLineSize) Shard {
+#if HASHMAP_HAS_SHARED_MEMORY
+        pthread_mutex_t mutex;
+#endif
+        SeqLock seq;
+        // Index + 1 of the slot being changed (kRebuilding during compact).
+        // Set before and cleared after the slot bytes are written; see
+        // mark_dirty.
+        std::atomic<uint64_t> dirty;
+        std::atomic<uint64_t> size;
+        // Full plus tombstoned slots; guarded by `mutex`.
+        uint64_t used;
+    };
+
+    struct Slot {
+        uint8_t state;
+        K key;
+        V value;
+    };
+
+    // Holds a shard's lock for a scope, repairing the shard first if its
+    // last owner died holding it.
+    class WriteGuard {
+    public:
+        WriteGuard(SharedHashMap& map, Shard& shard) : shard(shard) {
+            map.lock(shard);
+        }
+        ~WriteGuard() {
+            unlock(shard);
+        }
+
+    private:
+        Shard& shard;
+    };
+
+    static size_t round64(size_t bytes) {
+        return (bytes + kCacheLineSize - 1) & ~(kCacheLineSize - 1);
+    }
+
+    static size_t max_load(size_t slots) {
+        return slots - slots / 4;
+    }
+
+    static size_t shard_slots(size_t capacity) {
+        size_t per_shard = (capacity + SZ - 1) / SZ;
+        size_t slots = kMinShardSlots;
+        while (max_load(slots) < per_shard) {
+            slots *= 2;
+        }
+        return slots;
+    }
+
+    static size_t shard_bytes(size_t slots) {
+        return round64(sizeof(Shard) + slots * sizeof(Slot));
+    }
+
+    static size_t segment_bytes(size_t slots) {
+        return round64(sizeof(Header)) + SZ * shard_bytes(slots);
+    }
+
+    const Header& header() const {
+        return *reinterpret_cast<const Header*>(base);
+    }
+
+    Header& header() {
+        return *reinterpret_cast<Header*>(base);
+    }
+
+    Shard& shard_at(int s) const {
+        return *reinterpret_cast<Shard*>(base + round64(sizeof(Header)) + s * shard_bytes(header().slots));
+    }
+
+    Shard& shard_for(size_t hash_val) const {
+        return shard_at(static_cast<int>(reduce_hash<SZ>(hash_val)));
+    }
+
+    static Slot* slots(Shard& shard) {
+        return reinterpret_cast<Slot*>(reinterpret_cast<char*>(&shard) + sizeof(Shard));
+    }
+
+    size_t slot_count() const {
+        return header().slots;
+    }
+
+    // Same Fibonacci spread as InlineTable: the top bits of the product.
+    size_t home(size_t hash_val) const {
+        return static_cast<size_t>((static_cast<uint64_t>(hash_val) * 0x9E3779B97F4A7C15ull) >> shift);
+    }
+
+    // Bounded by the slot count, so a probe racing a writer cannot spin.
+    size_t find(Shard& shard, const K& key, size_t hash_val) const {
+        Slot* s = slots(shard);
+        size_t mask = slot_count() - 1;
+        for (size_t i = home(hash_val), n = 0; n <= mask; i = (i + 1) & mask, ++n) {
+            if (s[i].state == kEmpty) {
+                return kNotFound;
+            }
+            if (s[i].state == kFull && KeyEqual()(s[i].key, key)) {
+                return i;
+            }
+        }
+        return kNotFound;
+    }
+
+    // Caller holds the shard lock. Stores `value` under `key` (an existing
+    // entry only if `overwrite`); returns the key's slot and whether `value`
+    // was stored, or kNotFound if the shard is full.
+    std::pair<size_t, bool> put(Shard& shard, const K& key, const V& value, size_t hash_val, bool overwrite) {
+        size_t idx = find(shard, key, hash_val);
+        if (idx != kNotFound) {
+            if (overwrite) {
+                begin_change(shard, idx);
+                slots(shard)[idx].value = value;
+                end_change(shard);
+            }
+            return {idx, overwrite};
+        }
+        if (shard.size.load(std::memory_order_relaxed) + 1 > max_load(slot_count())) {
+            return {kNotFound, false};
+        }
+        if (shard.used + 1 > max_load(slot_count())) {
+            compact(shard);
+        }
+        Slot* s = slots(shard);
+        size_t mask = slot_count() - 1;
+        idx = home(hash_val);
+        while (s[idx].state == kFull) {
+            idx = (idx + 1) & mask;
+        }
+        begin_change(shard, idx);
+        shard.used += s[idx].state == kEmpty;
+        s[idx].key = key;
+        s[idx].value = value;
+        s[idx].state = kFull;
+        shard.size.fetch_add(1, std::memory_order_relaxed);
+        end_change(shard);
+        return {idx, true};
+    }
+
+    // Caller is inside begin_change. Leaves a tombstone, or an empty slot
+    // (clearing the tombstones before it) when no probe runs past it.
+    void erase_at(Shard& shard, size_t idx) {
+        Slot* s = slots(shard);
+        size_t mask = slot_count() - 1;
+        shard.size.fetch_sub(1, std::memory_order_relaxed);
+        if (s[(idx + 1) & mask].state != kEmpty) {
+            s[idx].state = kTombstone;
+            return;
+        }
+        s[idx].state = kEmpty;
+        --shard.used;
+        for (size_t i = (idx - 1) & mask; s[i].state == kTombstone; i = (i - 1) & mask) {
+            s[i].state = kEmpty;
+            --shard.used;
+        }
+    }
+
+    // Rebuilds the shard's slots without tombstones, in place. The live
+    // entries are staged in this process's memory while the slots are
+    // rewritten, so if it dies before finishing, recover() cannot tell them
+    // apart from stale slots and empties the shard instead.
+    void compact(Shard& shard) {
+        Slot* s = slots(shard);
+        std::vector<std::pair<K, V>> live;
+        live.reserve(shard.size.load(std::memory_order_relaxed));
+        for (size_t i = 0; i < slot_count(); ++i) {
+            if (s[i].state == kFull) {
+                live.emplace_back(s[i].key, s[i].value);
+            }
+        }
+        shard.seq.write_begin();
+        mark_dirty(shard, kRebuilding);
+        for (size_t i = 0; i < slot_count(); ++i) {
+            s[i].state = kEmpty;
+        }
+        size_t mask = slot_count() - 1;
+        for (auto& [key, value] : live) {
+            size_t idx = home(hasher(key));
+            while (s[idx].state != kEmpty) {
+                idx = (idx + 1) & mask;
+            }
+            s[idx].key = key;
+            s[idx].value = value;
+            s[idx].state = kFull;
+        }
+        shard.used = live.size();
+        mark_dirty(shard, 0);
+        shard.seq.write_end();
+    }
+
+    static void begin_change(Shard& shard, size_t idx) {
+        shard.seq.write_begin();
+        mark_dirty(shard, idx + 1);
+    }
+
+    static void end_change(Shard& shard) {
+        mark_dirty(shard, 0);
+        shard.seq.write_end();
+    }
+
+    // Recovery trusts `dirty` to name every slot a dead owner may have left
+    // half-written, so the compiler must not move slot stores across it in
+    // either direction. Only the owner's own death matters here, not other
+    // threads, so a signal fence is enough.
+    static void mark_dirty(Shard& shard, uint64_t value) {
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+        shard.dirty.store(value, std::memory_order_relaxed);
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+    }
+
+    // EOWNERDEAD hands over the lock of a writer that died holding it. If
+    // this process dies too before marking it consistent, the next writer
+    // gets EOWNERDEAD again and repeats the repair.
+    void lock(Shard& shard) {
+#if HASHMAP_HAS_SHARED_MEMORY
+        int rc = ::pthread_mutex_lock(&shard.mutex);
+        if (rc == EOWNERDEAD) {
+            recover(shard);
+            rc = ::pthread_mutex_consistent(&shard.mutex);
+        }
+        if (rc != 0) {
+            throw std::runtime_error("shared map: cannot lock shard");
+        }
+#else
+        (void)shard;
+#endif
+    }
+
+    static void unlock(Shard& shard) {
+#if HASHMAP_HAS_SHARED_MEMORY
+        ::pthread_mutex_unlock(&shard.mutex);
+#else
+        (void)shard;
+#endif
+    }
+
+    // Called with the lock taken over from a dead owner. If it died inside a
+    // change, drops what it was changing (every entry, for a compaction) and
+    // recounts the shard.
+    void recover(Shard& shard) {
+        header().recoveries.fetch_add(1, std::memory_order_relaxed);
+        if ((shard.seq.read_begin() & 1) == 0) {
+            return;
+        }
+        Slot* s = slots(shard);
+        uint64_t dirty = shard.dirty.load(std::memory_order_relaxed);
+        if (dirty == kRebuilding) {
+            for (size_t i = 0; i < slot_count(); ++i) {
+                s[i].state = kEmpty;
+            }
+        } else if (dirty != 0 && dirty <= slot_count()) {
+            s[dirty - 1].state = kTombstone;
+        }
+        size_t size = 0;
+        size_t used = 0;
+        for (size_t i = 0; i < slot_count(); ++i) {
+            if (s[i].state != kEmpty) {
+                s[i].state = s[i].state == kFull ? kFull : kTombstone;
+                size += s[i].state == kFull;
+                ++used;
+            }
+        }
+        shard.size.store(size, std::memory_order_relaxed);
+        shard.used = used;
+        end_change(shard);
+    }
+
+    bool init(size_t slots_per_shard) {
+        // ftruncate zero-fills the segment: every slot starts out kEmpty.
+        Header* h = new (base) Header{};
+        std::memcpy(h->magic, kMagic, sizeof(kMagic));
+        h->shards = SZ;
+        h->slot_bytes = sizeof(Slot);
+        h->key_bytes = sizeof(K);
+        h->value_bytes = sizeof(V);
+        h->slots = slots_per_shard;
+        h->shard_bytes = shard_bytes(slots_per_shard);
+        shift = 64 - static_cast<unsigned>(__builtin_ctzll(slots_per_shard));
+#if HASHMAP_HAS_SHARED_MEMORY
+        pthread_mutexattr_t attr;
+        if (::pthread_mutexattr_init(&attr) != 0) {
+            return false;
+        }
+        bool ok = ::pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED) == 0 &&
+                  ::pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST) == 0;
+        for (int s = 0; s < SZ && ok; ++s) {
+            Shard* shard = new (&shard_at(s)) Shard{};
+            ok = ::pthread_mutex_init(&shard->mutex, &attr) == 0;
+        }
+        ::pthread_mutexattr_destroy(&attr);
+#else
+        bool ok = false;
+#endif
+        if (ok) {
+            h->ready.store(1, std::memory_order_release);
+        }
+        return ok;
+    }
+
+    bool attach() {
+        const Header& h = header();
+        auto deadline = std::chrono::steady_clock::now() + kAttachTimeout;
+        while (h.ready.load(std::memory_order_acquire) == 0) {
+            if (std::chrono::steady_clock::now() > deadline) {
+                return false;
+            }
+            std::this_thread::yield();
+        }
+        if (std::memcmp(h.magic, kMagic, sizeof(kMagic)) != 0 || h.shards != SZ || h.slot_bytes != sizeof(Slot) ||
+            h.key_bytes != sizeof(K) || h.value_bytes != sizeof(V) ||
+            h.slots < kMinShardSlots || (h.slots & (h.slots - 1)) != 0 || h.shard_bytes != shard_bytes(h.slots) ||
+            segment_bytes(h.slots) != mapped_bytes) {
+            return false;
+        }
+        shift = 64 - static_cast<unsigned>(__builtin_ctzll(h.slots));
+        return true;
+    }
+
+#if HASHMAP_HAS_SHARED_MEMORY
+    // The creator sizes the segment right after creating it; wait for that.
+    static size_t wait_for_size(int fd) {
+        auto deadline = std::chrono::steady_clock::now() + kAttachTimeout;
+        struct stat st;
+        while (::fstat(fd, &st) == 0 && st.st_size == 0 && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::yield();
+        }
+        return static_cast<size_t>(st.st_size);
+    }
+#endif
+
+    void unmap() {
+#if HASHMAP_HAS_SHARED_MEMORY
+        if (base) {
+            ::munmap(base, mapped_bytes);
+            base = nullptr;
+        }
+#endif
+    }
+
+    Hash hasher;
+    char* base = nullptr;
+    size_t mapped_bytes = 0;
+    unsigned shift = 0;
+};
@@ -0,0 +1,191 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+// Per-shard memory pool for table storage. Requests up to kMaxBlock bytes are
+// rounded up to a power-of-two size class and served from 64 KiB chunks,
+// first from the class's free list, otherwise by bumping through the current
+// chunk; freed blocks go back onto their class's free list rather than to the
+// global allocator, so steady-state churn in one shard never touches malloc
+// and never contends with other shards. Larger requests go straight to
+// operator new.
+//
+// Chunks are aligned to their size, so a block finds its chunk header by
+// masking its address; the header counts live blocks and trim() hands fully
+// free chunks back to the system.
+//
+// Not thread-safe: HashMap only allocates from a shard's arena under that
+// shard's write lock.
+class SlabArena {
+public:
+    static constexpr size_t kChunkSize = size_t(1) << 16;
+    static constexpr size_t kMinBlock = 16;
+    static constexpr size_t kMaxBlock = kChunkSize / 4;
+    static constexpr size_t kClasses = 11;  // 16 B .. 16 KiB
+
+    SlabArena() = default;
+    SlabArena(const SlabArena&) = delete;
+    SlabArena& operator=(const SlabArena&) = delete;
+
+    ~SlabArena() {
+        for (Chunk* chunk : chunks) {
+            ::operator delete(chunk, std::align_val_t(kChunkSize));
+        }
+    }
+
+    void* allocate(size_t bytes, size_t align) {
+        if (bytes > kMaxBlock || align > kMinBlock) {
+            return ::operator new(bytes, std::align_val_t(std::max(align, kMinBlock)));
+        }
+        size_t cls = size_class(bytes);
+        void* p;
+        if (FreeBlock* block = free_lists[cls]) {
+            free_lists[cls] = block->next;
+            p = block;
+        } else {
+            size_t size = kMinBlock << cls;
+            if (!current || bump + size > reinterpret_cast<char*>(current) + kChunkSize) {
+                new_chunk();
+            }
+            p = bump;
+            bump += size;
+        }
+        ++chunk_of(p)->live;
+        return p;
+    }
+
+    void deallocate(void* p, size_t bytes, size_t align) {
+        if (bytes > kMaxBlock || align > kMinBlock) {
+            ::operator delete(p, std::align_val_t(std::max(align, kMinBlock)));
+            return;
+        }
+        size_t cls = size_class(bytes);
+        free_lists[cls] = new (p) FreeBlock{free_lists[cls]};
+        --chunk_of(p)->live;
+    }
+
+    // Returns chunks without live blocks to the system; returns bytes released.
+    size_t trim() {
+        auto is_empty = [](const Chunk* chunk) { return chunk->live == 0; };
+        if (std::none_of(chunks.begin(), chunks.end(), is_empty)) {
+            return 0;
+        }
+        for (FreeBlock*& head : free_lists) {
+            FreeBlock** link = &head;
+            while (*link) {
+                if (chunk_of(*link)->live == 0) {
+                    *link = (*link)->next;
+                } else {
+                    link = &(*link)->next;
+                }
+            }
+        }
+        if (current && current->live == 0) {
+            current = nullptr;
+            bump = nullptr;
+        }
+        size_t before = chunks.size();
+        chunks.erase(std::remove_if(chunks.begin(), chunks.end(), [&](Chunk* chunk) {
+                         if (!is_empty(chunk)) {
+                             return false;
+                         }
+                         ::operator delete(chunk, std::align_val_t(kChunkSize));
+                         return true;
+                     }),
+                     chunks.end());
+        return (before - chunks.size()) * kChunkSize;
+    }
+
+    // Bytes currently held in chunks (large blocks not included).
+    size_t reserved_bytes() const {
+        return chunks.size() * kChunkSize;
+    }
+
+private:
+    struct alignas(kMinBlock) Chunk {
+        size_t live = 0;
+    };
+
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    static size_t size_class(size_t bytes) {
+        size_t rounded = bytes <= kMinBlock ? kMinBlock : size_t(1) << (64 - __builtin_clzll(bytes - 1));
+        return static_cast<size_t>(__builtin_ctzll(rounded)) - static_cast<size_t>(__builtin_ctzll(kMinBlock));
+    }
+
+    static Chunk* chunk_of(const void* p) {
+        return reinterpret_cast<Chunk*>(reinterpret_cast<uintptr_t>(p) & ~(kChunkSize - 1));
+    }
+
+    void new_chunk() {
+        // The unused tail of the previous chunk, smaller than the block that
+        // did not fit, is abandoned.
+        current = new (::operator new(kChunkSize, std::align_val_t(kChunkSize))) Chunk();
+        chunks.push_back(current);
+        bump = reinterpret_cast<char*>(current) + sizeof(Chunk);
+    }
+
+    FreeBlock* free_lists[kClasses] = {};
+    std::vector<Chunk*> chunks;
+    Chunk* current = nullptr;
+    char* bump = nullptr;
+};
+
+// Standard allocator over a SlabArena. A default-constructed SlabAllocator
+// has no arena and falls back to operator new, so containers that build
+// temporaries without propagating the allocator stay correct. HashMap gives
+// every shard its own arena when its Allocator is a SlabAllocator.
+template <typename T>
+class SlabAllocator {
+public:
+    using value_type = T;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    SlabAllocator() = default;
+    explicit SlabAllocator(SlabArena* arena) : arena(arena) {}
+
+    template <typename U>
+    SlabAllocator(const SlabAllocator<U>& other) : arena(other.arena) {}
+
+    T* allocate(size_t n) {
+        if (n > std::numeric_limits<size_t>::max() / sizeof(T)) {
+            throw std::bad_array_new_length();
+        }
+        if (!arena) {
+            return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(alignof(T))));
+        }
+        return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* p, size_t n) {
+        if (!arena) {
+            ::operator delete(p, std::align_val_t(alignof(T)));
+            return;
+        }
+        arena->deallocate(p, n * sizeof(T), alignof(T));
+    }
+
+    template <typename U>
+    bool operator==(const SlabAllocator<U>& other) const {
+        return arena == other.arena;
+    }
+
+    template <typename U>
+    bool operator!=(const SlabAllocator<U>& other) const {
+        return arena != other.arena;
+    }
+
+private:
+    template <typename U>
+    friend class SlabAllocator;
+
+    SlabArena* arena = nullptr;
+};
@@ -0,0 +1,166 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <fstream>
+#include <iterator>
+#endif
+
+// Binary encoding of keys and values for HashMap::save_snapshot and
+// load_snapshot. Trivially copyable types and std::string work out of the
+// box; other types specialize Serializer<T> with the same three functions.
+template <typename T, typename Enable = void>
+struct Serializer;
+
+template <typename T>
+struct Serializer<T, std::enable_if_t<std::is_trivially_copyable_v<T>>> {
+    static size_t size(const T&) {
+        return sizeof(T);
+    }
+
+    static void write(const T& value, char* out) {
+        std::memcpy(out, &value, sizeof(T));
+    }
+
+    static T read(const char* in, size_t n) {
+        if (n != sizeof(T)) {
+            throw std::runtime_error("snapshot: field size mismatch");
+        }
+        alignas(T) unsigned char buf[sizeof(T)];
+        std::memcpy(buf, in, sizeof(T));
+        return *std::launder(reinterpret_cast<T*>(buf));
+    }
+};
+
+template <>
+struct Serializer<std::string> {
+    static size_t size(const std::string& value) {
+        return value.size();
+    }
+
+    static void write(const std::string& value, char* out) {
+        std::memcpy(out, value.data(), value.size());
+    }
+
+    static std::string read(const char* in, size_t n) {
+        return std::string(in, n);
+    }
+};
+
+namespace snapshot_detail {
+
+// File layout: Header, one block of records per source shard, then the
+// Directory locating every block. A record is a RecordHeader followed by the
+// key bytes and the value bytes. All integers are host-endian; snapshots are
+// meant for restarting on the same machine type, not for exchange.
+inline constexpr char kMagic[8] = {'H', 'M', 'S', 'N', 'A', 'P', '\0', '\1'};
+inline constexpr uint32_t kVersion = 1;
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t blocks;
+    uint64_t entries;
+    uint64_t directory_offset;
+};
+
+struct Directory {
+    uint64_t offset;
+    uint64_t bytes;
+    uint64_t entries;
+};
+
+struct RecordHeader {
+    uint32_t key_bytes;
+    uint32_t value_bytes;
+    uint64_t ttl_ns;  // remaining lifetime at save time, 0 = never expires
+};
+
+// Appends one record to `out`.
+template <typename K, typename V>
+void append_record(std::string& out, const K& key, const V& value, uint64_t ttl_ns) {
+    size_t key_bytes = Serializer<K>::size(key);
+    size_t value_bytes = Serializer<V>::size(value);
+    RecordHeader rec{static_cast<uint32_t>(key_bytes), static_cast<uint32_t>(value_bytes), ttl_ns};
+    size_t at = out.size();
+    out.resize(at + sizeof(rec) + key_bytes + value_bytes);
+    std::memcpy(&out[at], &rec, sizeof(rec));
+    Serializer<K>::write(key, &out[at + sizeof(rec)]);
+    Serializer<V>::write(value, &out[at + sizeof(rec) + key_bytes]);
+}
+
+// Read-only view of a whole file: mmap where available, a heap copy otherwise.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path) {
+#if defined(__unix__) || defined(__APPLE__)
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("snapshot: cannot open " + path);
+        }
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            ::close(fd);
+            throw std::runtime_error("snapshot: cannot stat " + path);
+        }
+        size_ = static_cast<size_t>(st.st_size);
+        if (size_ > 0) {
+            void* p = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED) {
+                ::close(fd);
+                throw std::runtime_error("snapshot: cannot map " + path);
+            }
+            data_ = static_cast<const char*>(p);
+        }
+        ::close(fd);
+#else
+        std::ifstream in(path, std::ios::binary);
+        if (!in) {
+            throw std::runtime_error("snapshot: cannot open " + path);
+        }
+        copy_.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        data_ = copy_.data();
+        size_ = copy_.size();
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+#if defined(__unix__) || defined(__APPLE__)
+        if (data_) {
+            ::munmap(const_cast<char*>(data_), size_);
+        }
+#endif
+    }
+
+    const char* data() const {
+        return data_;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+#if !(defined(__unix__) || defined(__APPLE__))
+    std::vector<char> copy_;
+#endif
+};
+
+}  // namespace snapshot_detail
@@ -0,0 +1,44 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "locks/lock_stats.h"
+
+// Occupancy of one table engine. A chain is a bucket's entry list for
+// ChainedTable and an entry's probe sequence (in groups) for FlatTable.
+struct ChainStats {
+    size_t chains = 0;     // non-empty buckets / live entries
+    size_t total = 0;      // sum of chain lengths
+    size_t longest = 0;
+
+    ChainStats& operator+=(const ChainStats& other) {
+        chains += other.chains;
+        total += other.total;
+        longest = longest > other.longest ? longest : other.longest;
+        return *this;
+    }
+};
+
+struct ShardStats {
+    size_t size = 0;
+    size_t buckets = 0;
+    ChainStats chain;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    LockStats lock;
+};
+
+// Point-in-time view returned by HashMap::stats(). Occupancy figures are
+// always filled in; hit/miss and lock counters need HASHMAP_ENABLE_STATS.
+struct HashMapStats {
+    size_t size = 0;
+    size_t buckets = 0;
+    double load_factor = 0;
+    size_t max_chain = 0;
+    double mean_chain = 0;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    LockStats lock;
+    std::vector<ShardStats> shards;
+};
@@ -0,0 +1,18 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+#include "hashmap/hash.h"
+
+// Transparent hasher for std::string keys. Paired with std::equal_to<> it lets
+// HashMap look up std::string keys by std::string_view or const char* without
+// allocating a temporary string. Every form hashes the same bytes with
+// hash_bytes, so a string and a string_view of it always agree.
+struct StringHash {
+    using is_transparent = void;
+
+    size_t operator()(std::string_view str) const {
+        return static_cast<size_t>(hash_bytes(str.data(), str.size()));
+    }
+};
@@ -0,0 +1,113 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+// Hierarchical timing wheel: kLevels wheels of kSlots slots each, level L
+// slots spanning kSlots^L ticks. Scheduling is O(1); advancing the clock
+// fires the current level-0 slot and, every kSlots ticks, cascades the next
+// slot of the level above down into finer wheels. Deadlines beyond the top
+// level are parked in its furthest slot and re-filed when it cascades.
+//
+// The wheel only remembers which key to look at, not whether the entry still
+// exists or still has that deadline; the caller re-checks both when a timer
+// fires. Not thread-safe; HashMap keeps one per shard under its write lock.
+template <typename K>
+class TimerWheel {
+public:
+    static constexpr uint64_t kTickNs = 1000000;  // 1 ms
+    static constexpr size_t kSlotBits = 6;
+    static constexpr size_t kSlots = size_t(1) << kSlotBits;
+    static constexpr size_t kLevels = 4;
+
+    struct Timer {
+        K key;
+        size_t hash;
+        uint64_t deadline_ns;
+    };
+
+    explicit TimerWheel(uint64_t now_ns) : current_tick(now_ns / kTickNs) {}
+
+    void schedule(const K& key, size_t hash, uint64_t deadline_ns) {
+        if (deadline_ns / kTickNs <= current_tick) {
+            ready.push_back(Timer{key, hash, deadline_ns});
+            return;
+        }
+        file(Timer{key, hash, deadline_ns});
+        ++pending;
+    }
+
+    // Advances the clock towards `now_ns` and hands at most `max_timers` due
+    // timers to `on_expire(key, hash)`. Returns true while due timers remain,
+    // so callers can drop their lock between batches.
+    template <typename Fn>
+    bool advance(uint64_t now_ns, size_t max_timers, Fn&& on_expire) {
+        uint64_t target = now_ns / kTickNs;
+        if (pending == 0 && ready.empty()) {
+            current_tick = std::max(current_tick, target);
+        }
+        while (ready.size() < max_timers && current_tick < target) {
+            tick();
+        }
+        size_t fired = 0;
+        while (fired < max_timers && !ready.empty()) {
+            Timer timer = std::move(ready.front());
+            ready.pop_front();
+            on_expire(timer.key, timer.hash);
+            ++fired;
+        }
+        return !ready.empty() || current_tick < target;
+    }
+
+    size_t size() const {
+        return pending + ready.size();
+    }
+
+private:
+    void tick() {
+        ++current_tick;
+        // Cascade coarser levels first so their timers can land in finer
+        // slots that are cascading on this same tick.
+        size_t top = 0;
+        while (top + 1 < kLevels && (current_tick & ((uint64_t(1) << (kSlotBits * (top + 1))) - 1)) == 0) {
+            ++top;
+        }
+        for (size_t level = top; level >= 1; --level) {
+            auto& slot = wheels[level][(current_tick >> (kSlotBits * level)) & (kSlots - 1)];
+            std::vector<Timer> cascading;
+            cascading.swap(slot);
+            for (auto& timer : cascading) {
+                file(std::move(timer));
+            }
+        }
+        auto& slot = wheels[0][current_tick & (kSlots - 1)];
+        for (auto& timer : slot) {
+            ready.push_back(std::move(timer));
+        }
+        pending -= slot.size();
+        slot.clear();
+    }
+
+    void file(Timer timer) {
+        // Cascaded timers may be due on the current tick; level 0 fires it next.
+        uint64_t tick = std::max(timer.deadline_ns / kTickNs, current_tick);
+        uint64_t delta = tick - current_tick;
+        for (size_t level = 0; level < kLevels; ++level) {
+            if (delta < (uint64_t(1) << (kSlotBits * (level + 1))) || level + 1 == kLevels) {
+                if (level + 1 == kLevels && delta >= (uint64_t(1) << (kSlotBits * kLevels))) {
+                    tick = current_tick + (uint64_t(1) << (kSlotBits * kLevels)) - 1;
+                }
+                wheels[level][(tick >> (kSlotBits * level)) & (kSlots - 1)].push_back(std::move(timer));
+                return;
+            }
+        }
+    }
+
+    std::array<std::array<std::vector<Timer>, kSlots>, kLevels> wheels;
+    std::deque<Timer> ready;
+    uint64_t current_tick;
+    size_t pending = 0;
+};
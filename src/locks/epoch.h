@@ -0,0 +1,154 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Epoch-based memory reclamation for lock-free structures. A thread pins the
+// current global epoch (EpochGuard) before dereferencing shared nodes; nodes
+// unlinked from a structure are retired with the epoch at the time of
+// retirement and freed once the global epoch has moved two steps past it,
+// which can only happen after every thread pinned at that time has unpinned.
+//
+// The domain is process-wide. Each thread claims a record on first use and
+// releases it on exit; records are never freed, and a thread that picks up a
+// released record inherits its pending retirements.
+class EpochDomain {
+public:
+    static constexpr size_t kCollectEvery = 64;
+
+    static EpochDomain& global() {
+        static EpochDomain domain;
+        return domain;
+    }
+
+    void pin() {
+        Record* rec = local();
+        if (rec->nesting++ == 0) {
+            rec->state.store((epoch.load(std::memory_order_relaxed) << 1) | 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+    }
+
+    void unpin() {
+        Record* rec = local();
+        if (--rec->nesting == 0) {
+            rec->state.store(0, std::memory_order_release);
+        }
+    }
+
+    // Hands `p` to the domain; `deleter(p)` runs once no pinned thread can
+    // still reach it. The caller must have unlinked `p` already.
+    void retire(void* p, void (*deleter)(void*)) {
+        Record* rec = local();
+        rec->retired.push_back({p, deleter, epoch.load(std::memory_order_seq_cst)});
+        if (rec->retired.size() % kCollectEvery == 0) {
+            try_advance();
+            collect(rec);
+        }
+    }
+
+    template <typename T>
+    void retire(T* p) {
+        retire(p, [](void* q) { delete static_cast<T*>(q); });
+    }
+
+    uint64_t current_epoch() const {
+        return epoch.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Retired {
+        void* ptr;
+        void (*deleter)(void*);
+        uint64_t epoch;
+    };
+
+    struct Record {
+        // (pinned epoch << 1) | 1 while pinned, 0 otherwise.
+        std::atomic<uint64_t> state{0};
+        std::atomic<bool> in_use{true};
+        Record* next = nullptr;
+        // Owner-thread only.
+        int nesting = 0;
+        std::vector<Retired> retired;
+    };
+
+    struct Handle {
+        Record* rec = nullptr;
+        ~Handle() {
+            if (rec) {
+                rec->in_use.store(false, std::memory_order_release);
+            }
+        }
+    };
+
+    EpochDomain() = default;
+
+    Record* local() {
+        thread_local Handle handle;
+        if (!handle.rec) {
+            handle.rec = acquire();
+        }
+        return handle.rec;
+    }
+
+    Record* acquire() {
+        for (Record* rec = records.load(std::memory_order_acquire); rec; rec = rec->next) {
+            bool free = false;
+            if (!rec->in_use.load(std::memory_order_relaxed) &&
+                rec->in_use.compare_exchange_strong(free, true, std::memory_order_acquire)) {
+                return rec;
+            }
+        }
+        Record* rec = new Record();
+        rec->next = records.load(std::memory_order_relaxed);
+        while (!records.compare_exchange_weak(rec->next, rec, std::memory_order_release, std::memory_order_relaxed)) {
+        }
+        return rec;
+    }
+
+    // Moves the global epoch forward if every pinned thread has seen it.
+    void try_advance() {
+        uint64_t e = epoch.load(std::memory_order_seq_cst);
+        for (Record* rec = records.load(std::memory_order_acquire); rec; rec = rec->next) {
+            uint64_t s = rec->state.load(std::memory_order_seq_cst);
+            if ((s & 1) && (s >> 1) != e) {
+                return;
+            }
+        }
+        epoch.compare_exchange_strong(e, e + 1, std::memory_order_seq_cst);
+    }
+
+    void collect(Record* rec) {
+        uint64_t e = epoch.load(std::memory_order_acquire);
+        size_t kept = 0;
+        for (Retired& r : rec->retired) {
+            if (r.epoch + 2 <= e) {
+                r.deleter(r.ptr);
+            } else {
+                rec->retired[kept++] = r;
+            }
+        }
+        rec->retired.resize(kept);
+    }
+
+    std::atomic<uint64_t> epoch{0};
+    std::atomic<Record*> records{nullptr};
+};
+
+// Pins the calling thread for the guard's lifetime. Guards nest.
+class EpochGuard {
+public:
+    explicit EpochGuard(EpochDomain& domain = EpochDomain::global()) : domain(domain) {
+        domain.pin();
+    }
+    ~EpochGuard() {
+        domain.unpin();
+    }
+    EpochGuard(const EpochGuard&) = delete;
+    EpochGuard& operator=(const EpochGuard&) = delete;
+
+private:
+    EpochDomain& domain;
+};
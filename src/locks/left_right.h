@@ -0,0 +1,127 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include "locks/rw_lock.h"
+
+// Left-right concurrency control (Ramalhete & Correia) over two copies of T.
+// Readers announce themselves on a read indicator and read whichever copy is
+// live; they never wait for anything, so read latency does not depend on
+// writers. A writer (serialized by a mutex) applies its change to the idle
+// copy, flips readers onto it, waits for readers still on the old copy to
+// drain and then applies the same change there.
+//
+// Writes are applied twice, so a write function must be deterministic and
+// only throw (if at all) on its first application, before anything is
+// published. Memory is twice that of one T.
+template <typename T>
+class LeftRight {
+public:
+    static constexpr size_t kStripes = 16;
+
+    template <typename... Args>
+    explicit LeftRight(const Args&... args) : instances{T(args...), T(args...)} {}
+
+    LeftRight(const LeftRight&) = delete;
+    LeftRight& operator=(const LeftRight&) = delete;
+
+    // Calls fn(const T&) on the live copy; wait-free apart from fn itself.
+    template <typename Fn>
+    auto read(Fn&& fn) const -> decltype(fn(std::declval<const T&>())) {
+        size_t vi = version.load(std::memory_order_seq_cst);
+        Departure departure(indicators[vi]);
+        return fn(static_cast<const T&>(instances[live.load(std::memory_order_seq_cst)]));
+    }
+
+    // Calls fn(T&) on both copies and returns the first call's result.
+    template <typename Fn>
+    auto write(Fn&& fn) -> decltype(fn(std::declval<T&>())) {
+        std::lock_guard<std::mutex> guard(writer);
+        size_t lr = live.load(std::memory_order_relaxed);
+        if constexpr (std::is_void_v<decltype(fn(std::declval<T&>()))>) {
+            fn(instances[1 - lr]);
+            publish(lr);
+            fn(instances[lr]);
+        } else {
+            auto result = fn(instances[1 - lr]);
+            publish(lr);
+            fn(instances[lr]);
+            return result;
+        }
+    }
+
+private:
+    // Readers on one version, counted on cache-line padded stripes picked per
+    // thread so that arrivals from different cores do not share a line.
+    class ReadIndicator {
+    public:
+        void arrive() const {
+            stripes[stripe()].count.fetch_add(1, std::memory_order_seq_cst);
+        }
+
+        void depart() const {
+            stripes[stripe()].count.fetch_sub(1, std::memory_order_release);
+        }
+
+        bool empty() const {
+            for (const Stripe& s : stripes) {
+                if (s.count.load(std::memory_order_seq_cst) != 0) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+    private:
+        struct alignas(kCacheLineSize) Stripe {
+            mutable std::atomic<size_t> count{0};
+        };
+
+        static size_t stripe() {
+            thread_local size_t index = std::hash<std::thread::id>()(std::this_thread::get_id()) % kStripes;
+            return index;
+        }
+
+        Stripe stripes[kStripes];
+    };
+
+    struct Departure {
+        explicit Departure(const ReadIndicator& indicator) : indicator(indicator) {
+            indicator.arrive();
+        }
+        ~Departure() {
+            indicator.depart();
+        }
+        const ReadIndicator& indicator;
+    };
+
+    // Points new readers at the freshly written copy, then waits until no
+    // reader can still be on `old_live`.
+    void publish(size_t old_live) {
+        live.store(1 - old_live, std::memory_order_seq_cst);
+        size_t prev = version.load(std::memory_order_relaxed);
+        size_t next = 1 - prev;
+        wait_empty(indicators[next]);
+        version.store(next, std::memory_order_seq_cst);
+        wait_empty(indicators[prev]);
+    }
+
+    static void wait_empty(const ReadIndicator& indicator) {
+        for (int spins = 0; !indicator.empty(); ++spins) {
+            if (spins >= 64) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    T instances[2];
+    alignas(kCacheLineSize) std::atomic<size_t> live{0};
+    std::atomic<size_t> version{0};
+    ReadIndicator indicators[2];
+    std::mutex writer;
+};
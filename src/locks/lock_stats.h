@@ -0,0 +1,94 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Lock instrumentation is compiled in only when HASHMAP_ENABLE_STATS is set
+// (CMake option of the same name); otherwise RWLock carries no counters and
+// stats() snapshots report zeros.
+#ifndef HASHMAP_ENABLE_STATS
+#define HASHMAP_ENABLE_STATS 0
+#endif
+
+inline constexpr bool kStatsEnabled = HASHMAP_ENABLE_STATS != 0;
+
+// Snapshot of one lock's (or a sum of locks') counters. An acquisition is
+// contended when its first attempt failed; only those are timed, and
+// wait_histogram[i] counts waits of [2^(i-1), 2^i) nanoseconds.
+struct LockStats {
+    static constexpr size_t kWaitBuckets = 40;
+
+    uint64_t read_acquisitions = 0;
+    uint64_t write_acquisitions = 0;
+    uint64_t contended_reads = 0;
+    uint64_t contended_writes = 0;
+    uint64_t wait_ns_total = 0;
+    std::array<uint64_t, kWaitBuckets> wait_histogram{};
+
+    LockStats& operator+=(const LockStats& other) {
+        read_acquisitions += other.read_acquisitions;
+        write_acquisitions += other.write_acquisitions;
+        contended_reads += other.contended_reads;
+        contended_writes += other.contended_writes;
+        wait_ns_total += other.wait_ns_total;
+        for (size_t i = 0; i < kWaitBuckets; ++i) {
+            wait_histogram[i] += other.wait_histogram[i];
+        }
+        return *this;
+    }
+
+    // Upper bound (in ns) of the histogram bucket holding the q-quantile wait.
+    uint64_t wait_percentile_ns(double q) const {
+        uint64_t total = 0;
+        for (uint64_t n : wait_histogram) {
+            total += n;
+        }
+        uint64_t seen = 0;
+        for (size_t i = 0; i < kWaitBuckets; ++i) {
+            seen += wait_histogram[i];
+            if (total > 0 && seen >= q * total) {
+                return uint64_t(1) << i;
+            }
+        }
+        return 0;
+    }
+};
+
+// Live counters behind LockStats. They sit next to the lock they describe, so
+// bumping them dirties a line the acquiring thread already owns.
+class LockCounters {
+public:
+    void acquired(bool write) {
+        (write ? write_acquisitions : read_acquisitions).fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void waited(bool write, uint64_t ns) {
+        (write ? contended_writes : contended_reads).fetch_add(1, std::memory_order_relaxed);
+        wait_ns_total.fetch_add(ns, std::memory_order_relaxed);
+        size_t bucket = ns == 0 ? 0 : 64 - __builtin_clzll(ns);
+        wait_histogram[bucket < LockStats::kWaitBuckets ? bucket : LockStats::kWaitBuckets - 1].fetch_add(
+            1, std::memory_order_relaxed);
+    }
+
+    LockStats snapshot() const {
+        LockStats s;
+        s.read_acquisitions = read_acquisitions.load(std::memory_order_relaxed);
+        s.write_acquisitions = write_acquisitions.load(std::memory_order_relaxed);
+        s.contended_reads = contended_reads.load(std::memory_order_relaxed);
+        s.contended_writes = contended_writes.load(std::memory_order_relaxed);
+        s.wait_ns_total = wait_ns_total.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < LockStats::kWaitBuckets; ++i) {
+            s.wait_histogram[i] = wait_histogram[i].load(std::memory_order_relaxed);
+        }
+        return s;
+    }
+
+private:
+    std::atomic<uint64_t> read_acquisitions{0};
+    std::atomic<uint64_t> write_acquisitions{0};
+    std::atomic<uint64_t> contended_reads{0};
+    std::atomic<uint64_t> contended_writes{0};
+    std::atomic<uint64_t> wait_ns_total{0};
+    std::array<std::atomic<uint64_t>, LockStats::kWaitBuckets> wait_histogram{};
+};
@@ -1,60 +1,620 @@
 #include "rw_lock.h"
 
-RWLock::RWLock() : readers_(0), waiting_readers_(0), writers_(0), waiting_writers_(0) {
-    pthread_mutex_init(&lock, NULL);
-    pthread_cond_init(&read_cond, NULL);
-    pthread_cond_init(&write_cond, NULL);
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <ctime>
+#include <mutex>
+#include <thread>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#else
+    std::this_thread::yield();
+#endif
+}
+
+uint64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool expired(uint64_t deadline) {
+    return deadline != 0 && now_ns() >= deadline;
+}
+
+// Sleeps while `word` holds `expected`, until woken or `deadline` (0 = none).
+void futex_wait(std::atomic<uint32_t>& word, uint32_t expected, uint64_t deadline) {
+#if defined(__linux__)
+    timespec remaining;
+    timespec* timeout = nullptr;
+    if (deadline != 0) {
+        uint64_t now = now_ns();
+        if (now >= deadline) {
+            return;
+        }
+        remaining.tv_sec = static_cast<time_t>((deadline - now) / 1'000'000'000);
+        remaining.tv_nsec = static_cast<long>((deadline - now) % 1'000'000'000);
+        timeout = &remaining;
+    }
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT_PRIVATE, expected, timeout, nullptr, 0);
+#else
+    (void)word;
+    (void)expected;
+    (void)deadline;
+    std::this_thread::yield();
+#endif
+}
+
+void futex_wake_all(std::atomic<uint32_t>& word) {
+#if defined(__linux__)
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+#else
+    (void)word;
+#endif
+}
+
+// A thread parked in a TaskFair lock's queue. The releasing thread sets
+// `granted` once it holds the lock for it; the waiter may return (and go out
+// of scope) as soon as it sees that, so the wake-up only uses the address.
+struct BlockingWaiter : AsyncLockWaiter {
+    std::atomic<uint32_t> granted{0};
+
+    static void wake(AsyncLockWaiter* waiter) {
+        auto* self = static_cast<BlockingWaiter*>(waiter);
+        self->granted.store(1, std::memory_order_release);
+        futex_wake_all(self->granted);
+    }
+};
+
+template <typename Fairness>
+constexpr bool kReaderPreference = std::is_same_v<Fairness, ReaderPreference>;
+template <typename Fairness>
+constexpr bool kPhaseFair = std::is_same_v<Fairness, PhaseFair>;
+template <typename Fairness>
+constexpr bool kTaskFair = std::is_same_v<Fairness, TaskFair>;
+
+}  // namespace
+
+template <typename Fairness>
+struct BasicRWLock<Fairness>::AsyncQueue {
+    std::mutex mutex;
+    AsyncLockWaiter* head = nullptr;
+    AsyncLockWaiter* tail = nullptr;
+    // Queued writers, all of which are also counted in kWaitingWritersMask.
+    uint32_t writers = 0;
+};
+
+template <typename Fairness>
+BasicRWLock<Fairness>::~BasicRWLock() {
+    delete async_queue_.load(std::memory_order_relaxed);
+}
+
+// `phase_passed`: the caller has been waiting since before the last write
+// unlock (only PhaseFair cares).
+template <typename Fairness>
+bool BasicRWLock<Fairness>::reader_can_enter(uint32_t state, bool phase_passed) {
+    if ((state & kWriter) || (state & kReadersMask) == kReadersMask) {
+        return false;
+    }
+    if constexpr (kReaderPreference<Fairness>) {
+        return true;
+    } else if constexpr (kPhaseFair<Fairness>) {
+        return !(state & kWaitingWritersMask) || (phase_passed && (state & kReaderTurn));
+    } else if constexpr (kTaskFair<Fairness>) {
+        // Anyone already queued goes first.
+        return !(state & (kWaitingWritersMask | kAsyncWaiting));
+    } else {
+        // Writer preference: a waiting writer holds off new readers.
+        return !(state & kWaitingWritersMask);
+    }
+}
+
+template <typename Fairness>
+bool BasicRWLock<Fairness>::writer_can_enter(uint32_t state) {
+    if (state & (kWriter | kReadersMask)) {
+        return false;
+    }
+    if constexpr (kPhaseFair<Fairness>) {
+        return !(state & kReaderTurn);
+    }
+    return true;
+}
+
+template <typename Fairness>
+void BasicRWLock<Fairness>::note_acquired(bool writer) {
+#if HASHMAP_ENABLE_STATS
+    counters_.acquired(writer);
+#else
+    (void)writer;
+#endif
+}
+
+template <typename Fairness>
+bool BasicRWLock<Fairness>::try_lock(bool writer) {
+    uint32_t state = state_.load(std::memory_order_relaxed);
+    bool acquired;
+    if (writer) {
+        bool queued = kTaskFair<Fairness> && (state & kAsyncWaiting);
+        acquired = !queued && writer_can_enter(state) &&
+                   state_.compare_exchange_strong(state, state | kWriter, std::memory_order_acquire);
+    } else {
+        acquired = reader_can_enter(state, false) &&
+                   state_.compare_exchange_strong(state, state + kReaderOne, std::memory_order_acquire);
+    }
+    if (acquired) {
+        note_acquired(writer);
+    }
+    return acquired;
+}
+
+template <typename Fairness>
+bool BasicRWLock<Fairness>::try_lock_for(bool writer, std::chrono::nanoseconds timeout) {
+    if (try_lock(writer)) {
+        return true;
+    }
+    uint64_t deadline = now_ns() + static_cast<uint64_t>(std::max<int64_t>(timeout.count(), 1));
+    if constexpr (kTaskFair<Fairness>) {
+        return lock_queued(writer, deadline);
+    }
+    return writer ? writer_lock_slow(deadline) : reader_lock_slow(deadline, kReaderOne);
+}
+
+// Only acquisitions whose first attempt fails read the clock.
+template <typename Fairness>
+void BasicRWLock<Fairness>::reader_lock() {
+    if (try_lock(false)) {
+        return;
+    }
+#if HASHMAP_ENABLE_STATS
+    uint64_t start = now_ns();
+#endif
+    if constexpr (kTaskFair<Fairness>) {
+        lock_queued(false, 0);
+    } else {
+        reader_lock_slow(0, kReaderOne);
+    }
+#if HASHMAP_ENABLE_STATS
+    counters_.waited(false, now_ns() - start);
+#endif
+}
+
+// `add` is what entering adds to the state: one reader, plus kUpgrader for
+// the upgradable lock.
+template <typename Fairness>
+bool BasicRWLock<Fairness>::reader_lock_slow(uint64_t deadline, uint32_t add) {
+    bool upgradable = add & kUpgrader;
+    uint32_t phase = phase_.load(std::memory_order_acquire);
+    auto can_enter = [&](uint32_t state) {
+        bool phase_passed = phase_.load(std::memory_order_acquire) != phase;
+        return reader_can_enter(state, phase_passed) && !(upgradable && (state & kUpgrader));
+    };
+
+    for (int spin = 0; spin < kSpinLimit; ++spin) {
+        uint32_t state = state_.load(std::memory_order_relaxed);
+        if (can_enter(state) && state_.compare_exchange_weak(state, state + add, std::memory_order_acquire)) {
+            note_acquired(false);
+            return true;
+        }
+        cpu_relax();
+    }
+
+    uint32_t state = state_.load(std::memory_order_relaxed);
+    while (true) {
+        if (can_enter(state)) {
+            if (state_.compare_exchange_weak(state, state + add, std::memory_order_acquire)) {
+                note_acquired(false);
+                return true;
+            }
+            continue;
+        }
+        if (expired(deadline)) {
+            if constexpr (kPhaseFair<Fairness>) {
+                // Do not leave writers waiting on a reader turn nobody takes.
+                while ((state & kReaderTurn) && !(state & kReadersMask)) {
+                    if (state_.compare_exchange_weak(state, state & ~kReaderTurn, std::memory_order_relaxed)) {
+                        futex_wake_all(state_);
+                        break;
+                    }
+                }
+            }
+            return false;
+        }
+        if (!(state & kReadersWaiting) &&
+            !state_.compare_exchange_weak(state, state | kReadersWaiting, std::memory_order_relaxed)) {
+            continue;
+        }
+        futex_wait(state_, state | kReadersWaiting, deadline);
+        state = state_.load(std::memory_order_relaxed);
+    }
+}
+
+template <typename Fairness>
+void BasicRWLock<Fairness>::reader_unlock() {
+    release_readers(kReaderOne);
+}
+
+template <typename Fairness>
+void BasicRWLock<Fairness>::release_readers(uint32_t sub) {
+    uint32_t prev = state_.fetch_sub(sub, std::memory_order_release);
+    uint32_t left = (prev & kReadersMask) - 1;
+    bool woke = false;
+    if constexpr (kPhaseFair<Fairness>) {
+        // The reader phase ends with its last reader.
+        if (left == 0 && (prev & kReaderTurn)) {
+            state_.fetch_and(~kReaderTurn, std::memory_order_relaxed);
+            futex_wake_all(state_);
+            woke = true;
+        }
+    }
+    // A waiting writer needs every reader gone; an upgrading holder needs
+    // every reader but itself gone.
+    bool writer_may_enter = left == 0 || (left == 1 && (prev & kUpgrader) && !(sub & kUpgrader));
+    if (!woke && writer_may_enter && (prev & kWaitingWritersMask)) {
+        futex_wake_all(state_);
+        woke = true;
+    }
+    // Would-be upgraders sleep as waiting readers.
+    if (!woke && (sub & kUpgrader) && (prev & kReadersWaiting)) {
+        futex_wake_all(state_);
+    }
+    if (left == 0 && (prev & kAsyncWaiting)) {
+        wake_async();
+    }
+}
+
+template <typename Fairness>
+void BasicRWLock<Fairness>::writer_lock() {
+    if (try_lock(true)) {
+        return;
+    }
+#if HASHMAP_ENABLE_STATS
+    uint64_t start = now_ns();
+#endif
+    if constexpr (kTaskFair<Fairness>) {
+        lock_queued(true, 0);
+    } else {
+        writer_lock_slow(0);
+    }
+#if HASHMAP_ENABLE_STATS
+    counters_.waited(true, now_ns() - start);
+#endif
+}
+
+template <typename Fairness>
+bool BasicRWLock<Fairness>::writer_lock_slow(uint64_t deadline) {
+    for (int spin = 0; spin < kSpinLimit; ++spin) {
+        uint32_t state = state_.load(std::memory_order_relaxed);
+        if (writer_can_enter(state) &&
+            state_.compare_exchange_weak(state, state | kWriter, std::memory_order_acquire)) {
+            note_acquired(true);
+            return true;
+        }
+        cpu_relax();
+    }
+
+    uint32_t state = state_.fetch_add(kWaitingWriterOne, std::memory_order_relaxed) + kWaitingWriterOne;
+    while (true) {
+        if (writer_can_enter(state)) {
+            if (state_.compare_exchange_weak(state, (state - kWaitingWriterOne) | kWriter,
+                                             std::memory_order_acquire)) {
+                note_acquired(true);
+                return true;
+            }
+            continue;
+        }
+        if (expired(deadline)) {
+            // Readers may have been held off only by this writer.
+            uint32_t prev = state_.fetch_sub(kWaitingWriterOne, std::memory_order_relaxed);
+            if (prev & kReadersWaiting) {
+                futex_wake_all(state_);
+            }
+            if (prev & kAsyncWaiting) {
+                wake_async();
+            }
+            return false;
+        }
+        futex_wait(state_, state, deadline);
+        state = state_.load(std::memory_order_relaxed);
+    }
+}
+
+template <typename Fairness>
+void BasicRWLock<Fairness>::write_unlock() {
+    uint32_t prev = end_write(0);
+    if (prev & (kWaitingWritersMask | kReadersWaiting)) {
+        futex_wake_all(state_);
+    }
+    if (prev & kAsyncWaiting) {
+        wake_async();
+    }
+}
+
+// Clears the writer bit (adding `add` in the same step) and returns the
+// previous state. Under PhaseFair, readers that slept through the write get
+// the next turn.
+template <typename Fairness>
+uint32_t BasicRWLock<Fairness>::end_write(uint32_t add) {
+    if constexpr (kPhaseFair<Fairness>) {
+        phase_.fetch_add(1, std::memory_order_release);
+        uint32_t prev = state_.load(std::memory_order_relaxed);
+        uint32_t next;
+        do {
+            next = ((prev & ~(kWriter | kReadersWaiting)) + add) | ((prev & kReadersWaiting) ? kReaderTurn : 0);
+        } while (!state_.compare_exchange_weak(prev, next, std::memory_order_release, std::memory_order_relaxed));
+        return prev;
+    } else if (add == 0) {
+        return state_.fetch_and(~(kWriter | kReadersWaiting), std::memory_order_release);
+    } else {
+        uint32_t prev = state_.load(std::memory_order_relaxed);
+        while (!state_.compare_exchange_weak(prev, (prev & ~(kWriter | kReadersWaiting)) + add,
+                                             std::memory_order_release, std::memory_order_relaxed)) {
+        }
+        return prev;
+    }
+}
+
+template <typename Fairness>
+void BasicRWLock<Fairness>::upgradable_lock() {
+    uint32_t state = state_.load(std::memory_order_relaxed);
+    if (reader_can_enter(state, false) && !(state & kUpgrader) &&
+        state_.compare_exchange_strong(state, state + kReaderOne + kUpgrader, std::memory_order_acquire)) {
+        note_acquired(false);
+        return;
+    }
+#if HASHMAP_ENABLE_STATS
+    uint64_t start = now_ns();
+#endif
+    reader_lock_slow(0, kReaderOne + kUpgrader);
+#if HASHMAP_ENABLE_STATS
+    counters_.waited(false, now_ns() - start);
+#endif
+}
+
+template <typename Fairness>
+void BasicRWLock<Fairness>::upgradable_unlock() {
+    release_readers(kReaderOne + kUpgrader);
+}
+
+// Registers as a waiting writer, so that (except under ReaderPreference) new
+// readers stay out, then waits until the upgrader is the only reader left.
+template <typename Fairness>
+void BasicRWLock<Fairness>::upgrade() {
+    uint32_t state = state_.fetch_add(kWaitingWriterOne, std::memory_order_relaxed) + kWaitingWriterOne;
+    for (int spin = 0;;) {
+        if (!(state & kWriter) && (state & kReadersMask) == kReaderOne) {
+            if (state_.compare_exchange_weak(state, (state - kWaitingWriterOne - kReaderOne) | kWriter,
+                                             std::memory_order_acquire)) {
+                note_acquired(true);
+                return;
+            }
+            continue;
+        }
+        if (spin < kSpinLimit) {
+            ++spin;
+            cpu_relax();
+        } else {
+            futex_wait(state_, state, 0);
+        }
+        state = state_.load(std::memory_order_relaxed);
+    }
 }
 
-RWLock::~RWLock() {
-    pthread_mutex_destroy(&lock);
-    pthread_cond_destroy(&read_cond);
-    pthread_cond_destroy(&write_cond);
+// Back from exclusive to upgradable: the upgrader becomes a reader again.
+template <typename Fairness>
+void BasicRWLock<Fairness>::downgrade() {
+    uint32_t prev = end_write(kReaderOne);
+    if (prev & kReadersWaiting) {
+        futex_wake_all(state_);
+    }
+    if (prev & kAsyncWaiting) {
+        wake_async();
+    }
 }
 
-void RWLock::reader_lock() {
-    pthread_mutex_lock(&lock);
-    if (writers_ > 0 || waiting_writers_ > 0) {
-        waiting_readers_ += 1;
-        while (writers_ > 0 || waiting_writers_ > 0) {
-            pthread_cond_wait(&read_cond, &lock);
+// TaskFair contended path: queue behind everyone already waiting and sleep
+// until the lock is handed over, or give up at the deadline.
+template <typename Fairness>
+bool BasicRWLock<Fairness>::lock_queued(bool writer, uint64_t deadline) {
+    BlockingWaiter waiter;
+    waiter.writer = writer;
+    waiter.on_acquired = &BlockingWaiter::wake;
+    if (lock_async(waiter)) {
+        return true;
+    }
+    while (!waiter.granted.load(std::memory_order_acquire)) {
+        if (expired(deadline)) {
+            if (cancel_async(waiter)) {
+                return false;
+            }
+            // Granted meanwhile; the wake-up is on its way.
+            while (!waiter.granted.load(std::memory_order_acquire)) {
+                cpu_relax();
+            }
+            return true;
+        }
+        futex_wait(waiter.granted, 0, deadline);
+    }
+    return true;
+}
+
+template <typename Fairness>
+typename BasicRWLock<Fairness>::AsyncQueue& BasicRWLock<Fairness>::async_queue() {
+    AsyncQueue* queue = async_queue_.load(std::memory_order_acquire);
+    if (!queue) {
+        auto* fresh = new AsyncQueue();
+        if (async_queue_.compare_exchange_strong(queue, fresh, std::memory_order_acq_rel)) {
+            queue = fresh;
+        } else {
+            delete fresh;
+        }
+    }
+    return *queue;
+}
+
+template <typename Fairness>
+bool BasicRWLock<Fairness>::lock_async(AsyncLockWaiter& waiter) {
+    if (try_lock(waiter.writer)) {
+        return true;
+    }
+    AsyncQueue& queue = async_queue();
+    AsyncLockWaiter* granted;
+    {
+        std::lock_guard<std::mutex> guard(queue.mutex);
+        waiter.next = nullptr;
+        (queue.tail ? queue.tail->next : queue.head) = &waiter;
+        queue.tail = &waiter;
+        if (waiter.writer) {
+            ++queue.writers;
+            state_.fetch_add(kWaitingWriterOne, std::memory_order_relaxed);
         }
-        waiting_readers_ -= 1;
+        state_.fetch_or(kAsyncWaiting, std::memory_order_relaxed);
+        // The holder may have released the lock before it could see
+        // kAsyncWaiting, so try again now that it is set.
+        granted = grant_async(queue);
     }
-    readers_ += 1;
-    pthread_mutex_unlock(&lock);
+    bool self_granted = false;
+    for (AsyncLockWaiter* w = granted; w; w = w->next) {
+        self_granted |= w == &waiter;
+    }
+    resume_granted(granted, &waiter);
+    return self_granted;
 }
 
-void RWLock::reader_unlock() {
-    pthread_mutex_lock(&lock);
-    readers_ -= 1;
-    if (waiting_writers_ > 0) {
-        pthread_cond_broadcast(&write_cond);
+// Removes a waiter that has not been granted yet; returns false if it already was.
+template <typename Fairness>
+bool BasicRWLock<Fairness>::cancel_async(AsyncLockWaiter& waiter) {
+    AsyncQueue& queue = async_queue();
+    AsyncLockWaiter* granted = nullptr;
+    bool found = false;
+    {
+        std::lock_guard<std::mutex> guard(queue.mutex);
+        AsyncLockWaiter* prev = nullptr;
+        for (AsyncLockWaiter** link = &queue.head; *link; prev = *link, link = &(*link)->next) {
+            if (*link == &waiter) {
+                *link = waiter.next;
+                if (queue.tail == &waiter) {
+                    queue.tail = prev;
+                }
+                found = true;
+                break;
+            }
+        }
+        if (found) {
+            if (waiter.writer) {
+                --queue.writers;
+                state_.fetch_sub(kWaitingWriterOne, std::memory_order_relaxed);
+            }
+            // Whoever queued behind it may be able to go now.
+            granted = grant_async(queue);
+        }
+    }
+    resume_granted(granted, nullptr);
+    if (found && (state_.load(std::memory_order_relaxed) & kReadersWaiting)) {
+        futex_wake_all(state_);
     }
-    pthread_mutex_unlock(&lock);
+    return found;
 }
 
-void RWLock::writer_lock() {
-    pthread_mutex_lock(&lock);
-    if (readers_ > 0 || writers_ > 0) {
-        waiting_writers_ += 1;
-        while (readers_ > 0 || writers_ > 0) {
-            pthread_cond_wait(&write_cond, &lock);
+// Caller holds queue.mutex. Takes the lock for waiters from the front of the
+// queue for as long as each can enter, and returns them as a list.
+template <typename Fairness>
+AsyncLockWaiter* BasicRWLock<Fairness>::grant_async(AsyncQueue& queue) {
+    AsyncLockWaiter* granted = nullptr;
+    AsyncLockWaiter** tail = &granted;
+    while (AsyncLockWaiter* w = queue.head) {
+        uint32_t state = state_.load(std::memory_order_relaxed);
+        bool acquired = false;
+        if (w->writer) {
+            while (!acquired && writer_can_enter(state)) {
+                acquired = state_.compare_exchange_weak(state, (state - kWaitingWriterOne) | kWriter,
+                                                        std::memory_order_acquire);
+            }
+        } else {
+            // Queued writers behind this reader must not hold it off; only
+            // blocked (synchronous) writers and upgraders do.
+            auto can_enter = [&](uint32_t s) {
+                if ((s & kWriter) || (s & kReadersMask) == kReadersMask) {
+                    return false;
+                }
+                if constexpr (kReaderPreference<Fairness>) {
+                    return true;
+                }
+                bool blocked_writers = ((s & kWaitingWritersMask) >> 16) != queue.writers;
+                if constexpr (kPhaseFair<Fairness>) {
+                    return !blocked_writers || (s & kReaderTurn);
+                }
+                return !blocked_writers;
+            };
+            while (!acquired && can_enter(state)) {
+                acquired = state_.compare_exchange_weak(state, state + kReaderOne, std::memory_order_acquire);
+            }
         }
-        waiting_writers_ -= 1;
+        if (!acquired) {
+            break;
+        }
+        note_acquired(w->writer);
+        if (w->writer) {
+            --queue.writers;
+        }
+        queue.head = w->next;
+        if (!queue.head) {
+            queue.tail = nullptr;
+        }
+        w->next = nullptr;
+        *tail = w;
+        tail = &w->next;
     }
-    writers_ += 1;
-    pthread_mutex_unlock(&lock);
+    if (!queue.head) {
+        uint32_t prev = state_.fetch_and(~kAsyncWaiting, std::memory_order_relaxed);
+        // TaskFair upgraders wait for the queue to drain.
+        if (kTaskFair<Fairness> && (prev & kReadersWaiting)) {
+            futex_wake_all(state_);
+        }
+    }
+    return granted;
 }
 
-void RWLock::write_unlock() {
-    pthread_mutex_lock(&lock);
-    writers_ -= 1;
-    if (waiting_writers_ > 0) {
-        pthread_cond_signal(&write_cond);
+template <typename Fairness>
+void BasicRWLock<Fairness>::wake_async() {
+    AsyncQueue* queue = async_queue_.load(std::memory_order_acquire);
+    if (!queue) {
+        return;
     }
-    else if (waiting_readers_ > 0) {
-        pthread_cond_broadcast(&read_cond);
+    AsyncLockWaiter* granted;
+    {
+        std::lock_guard<std::mutex> guard(queue->mutex);
+        granted = grant_async(*queue);
     }
-    pthread_mutex_unlock(&lock);
-}
\ No newline at end of file
+    resume_granted(granted, nullptr);
+}
+
+// Resumption may destroy a waiter, so its successor is read first.
+template <typename Fairness>
+void BasicRWLock<Fairness>::resume_granted(AsyncLockWaiter* granted, AsyncLockWaiter* self) {
+    while (granted) {
+        AsyncLockWaiter* next = granted->next;
+        if (granted != self) {
+            granted->on_acquired(granted);
+        }
+        granted = next;
+    }
+}
+
+template class BasicRWLock<WriterPreference>;
+template class BasicRWLock<ReaderPreference>;
+template class BasicRWLock<PhaseFair>;
+template class BasicRWLock<TaskFair>;
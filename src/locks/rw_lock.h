@@ -1,14 +1,108 @@
 #pragma once
+#include <atomic>
+#include <chrono>
 #include <cstddef>
-#include <pthread.h>
+#include <cstdint>
 #include <functional>
+#include <optional>
 #include <type_traits>
+#include <utility>
 
+#if defined(__cpp_impl_coroutine)
+#include <coroutine>
+#define HASHMAP_HAS_COROUTINES 1
+#else
+#define HASHMAP_HAS_COROUTINES 0
+#endif
 
-class RWLock {
+#include "locks/lock_stats.h"
+
+inline constexpr size_t kCacheLineSize = 64;
+
+// Fairness policies for BasicRWLock, i.e. who goes first when readers and
+// writers contend:
+//  - WriterPreference: a waiting writer holds off new readers (RWLock).
+//  - ReaderPreference: readers enter whenever no writer holds the lock, so
+//    reader latency is flat but a stream of readers can starve writers.
+//  - PhaseFair: readers that had to wait for a writer enter as soon as it
+//    leaves, ahead of the next waiting writer; readers arriving later queue
+//    behind that writer. Reader and writer phases alternate.
+//  - TaskFair: contended readers and writers are served in arrival order
+//    (consecutive readers together), at the cost of queueing every waiter.
+struct WriterPreference {};
+struct ReaderPreference {};
+struct PhaseFair {};
+struct TaskFair {};
+
+template <typename Fairness>
+class BasicRWLock;
+using RWLock = BasicRWLock<WriterPreference>;
+
+// Queue entry for a caller that must not park its thread while the lock is
+// contended (see BasicRWLock::lock_async).
+struct AsyncLockWaiter {
+    bool writer = false;
+    // Called once the lock is held on this waiter's behalf.
+    void (*on_acquired)(AsyncLockWaiter*) = nullptr;
+    AsyncLockWaiter* next = nullptr;
+};
+
+#if HASHMAP_HAS_COROUTINES
+template <typename Lock, typename Fn, typename Executor>
+class AsyncLockCall;
+
+// Resumes coroutines on the thread that released the lock.
+struct InlineExecutor {
+    void operator()(std::coroutine_handle<> handle) const {
+        handle.resume();
+    }
+};
+#endif
+
+// Read-write lock whose whole state is one 32-bit atomic word: active reader
+// count, waiting writer count, writer / upgrader bits and wake-up flags.
+// Uncontended acquire/release is a single atomic RMW; contended callers spin
+// briefly and then sleep on the word with a futex (plain yielding on
+// non-Linux systems). Fairness picks the policy above; the member functions
+// are compiled once per policy in rw_lock.cpp.
+//
+// Besides read/write there are try_* (never wait), try_*_for (wait at most a
+// timeout) and upgradable, a read lock that at most one holder at a time may
+// turn into the write lock without letting another writer in between.
+//
+// Coroutines can acquire it without blocking their thread: lock_async queues
+// a waiter that the releasing thread grants the lock to and then resumes.
+// Queued async writers count as waiting writers, so they hold off new readers
+// just like blocked ones. TaskFair puts blocked threads in that same queue.
+template <typename Fairness>
+class BasicRWLock {
 public:
-    RWLock();
-    ~RWLock();
+    // try_* return whether they ran a void callable, otherwise its result if
+    // they ran it.
+    template <typename R>
+    using TryResult = std::conditional_t<std::is_void_v<R>, bool, std::optional<R>>;
+
+    // Handed to the callable of upgradable(); write() runs its argument with
+    // the lock upgraded to exclusive and then downgrades it again.
+    class Upgrade {
+    public:
+        template <typename Callable>
+        auto write(Callable&& func) -> decltype(func()) {
+            lock.upgrade();
+            Release downgrade{lock, &BasicRWLock::downgrade};
+            return func();
+        }
+
+    private:
+        friend class BasicRWLock;
+        explicit Upgrade(BasicRWLock& lock) : lock(lock) {}
+        BasicRWLock& lock;
+    };
+
+    BasicRWLock() = default;
+    ~BasicRWLock();
+    BasicRWLock(const BasicRWLock&) = delete;
+    BasicRWLock& operator=(const BasicRWLock&) = delete;
 
     template <typename Callable, typename ...Args>
     auto read(Callable&& func, Args&&... args) -> decltype(func(args...)) {
@@ -48,15 +142,209 @@ public:
         }
     }
 
+    template <typename Callable>
+    auto try_read(Callable&& func) -> TryResult<decltype(func())> {
+        return run_if(try_lock(false), false, func);
+    }
+
+    template <typename Callable>
+    auto try_write(Callable&& func) -> TryResult<decltype(func())> {
+        return run_if(try_lock(true), true, func);
+    }
+
+    template <typename Rep, typename Period, typename Callable>
+    auto try_read_for(std::chrono::duration<Rep, Period> timeout, Callable&& func) -> TryResult<decltype(func())> {
+        return run_if(try_lock_for(false, std::chrono::duration_cast<std::chrono::nanoseconds>(timeout)), false, func);
+    }
+
+    template <typename Rep, typename Period, typename Callable>
+    auto try_write_for(std::chrono::duration<Rep, Period> timeout, Callable&& func) -> TryResult<decltype(func())> {
+        return run_if(try_lock_for(true, std::chrono::duration_cast<std::chrono::nanoseconds>(timeout)), true, func);
+    }
+
+    // Runs func(Upgrade&) holding the upgradable lock: readers may still
+    // enter, other upgraders and writers may not. Calling upgrade.write(fn)
+    // waits for the readers to leave and runs fn exclusively, so a
+    // check-then-modify sequence needs only one acquisition.
+    template <typename Callable>
+    auto upgradable(Callable&& func) -> decltype(func(std::declval<Upgrade&>())) {
+        upgradable_lock();
+        Release release{*this, &BasicRWLock::upgradable_unlock};
+        Upgrade upgrade(*this);
+        return func(upgrade);
+    }
+
+#if HASHMAP_HAS_COROUTINES
+    // Awaitable counterparts of read/write: `co_await lock.async_read(fn)`
+    // returns fn() called under the lock. If the lock is contended the
+    // coroutine is suspended instead of blocking its thread, and the releasing
+    // thread hands it to executor(handle) once the lock is held for it.
+    template <typename Fn, typename Executor = InlineExecutor>
+    AsyncLockCall<BasicRWLock, std::decay_t<Fn>, Executor> async_read(Fn&& fn, Executor executor = {}) {
+        return {*this, false, std::forward<Fn>(fn), std::move(executor)};
+    }
+
+    template <typename Fn, typename Executor = InlineExecutor>
+    AsyncLockCall<BasicRWLock, std::decay_t<Fn>, Executor> async_write(Fn&& fn, Executor executor = {}) {
+        return {*this, true, std::forward<Fn>(fn), std::move(executor)};
+    }
+#endif
+
+    // Takes the lock (for writing if `writer`) if that is possible right now.
+    bool try_lock(bool writer);
+
+    // Like try_lock, but waits up to `timeout` for the lock.
+    bool try_lock_for(bool writer, std::chrono::nanoseconds timeout);
+
+    // Returns true if the lock was taken immediately. Otherwise the waiter is
+    // queued (FIFO among async waiters) and waiter.on_acquired is called from
+    // the releasing thread once the lock is held on its behalf; the waiter
+    // must stay alive until then.
+    bool lock_async(AsyncLockWaiter& waiter);
+
+    // Releases a lock taken with try_lock or lock_async.
+    void unlock(bool writer) {
+        writer ? write_unlock() : reader_unlock();
+    }
+
+    // Acquisition and wait counters; all zero unless built with HASHMAP_ENABLE_STATS.
+    LockStats stats() const {
+#if HASHMAP_ENABLE_STATS
+        return counters_.snapshot();
+#else
+        return LockStats();
+#endif
+    }
+
 private:
+    // Calls (lock.*release)() when it goes out of scope.
+    struct Release {
+        BasicRWLock& lock;
+        void (BasicRWLock::*release)();
+        ~Release() {
+            (lock.*release)();
+        }
+    };
+
+    template <typename Callable>
+    auto run_if(bool acquired, bool writer, Callable& func) -> TryResult<decltype(func())> {
+        if (!acquired) {
+            return {};
+        }
+        Release release{*this, writer ? &BasicRWLock::write_unlock : &BasicRWLock::reader_unlock};
+        if constexpr (std::is_void_v<decltype(func())>) {
+            func();
+            return true;
+        } else {
+            return func();
+        }
+    }
+
     void reader_lock();
     void reader_unlock();
 
     void writer_lock();
     void write_unlock();
+
+    void upgradable_lock();
+    void upgradable_unlock();
+    void upgrade();
+    void downgrade();
+
+    // Slow paths; a zero deadline (steady clock, ns) waits forever. They
+    // return false only when the deadline passed.
+    bool reader_lock_slow(uint64_t deadline, uint32_t add);
+    bool writer_lock_slow(uint64_t deadline);
+    bool lock_queued(bool writer, uint64_t deadline);
+
+    void release_readers(uint32_t sub);
+    uint32_t end_write(uint32_t add);
+    void note_acquired(bool writer);
+
+    static bool reader_can_enter(uint32_t state, bool phase_passed);
+    static bool writer_can_enter(uint32_t state);
+
+    struct AsyncQueue;
+    AsyncQueue& async_queue();
+    AsyncLockWaiter* grant_async(AsyncQueue& queue);
+    bool cancel_async(AsyncLockWaiter& waiter);
+    void wake_async();
+    static void resume_granted(AsyncLockWaiter* granted, AsyncLockWaiter* self);
+
+private:
+    static constexpr uint32_t kReaderOne = 1;
+    static constexpr uint32_t kReadersMask = 0xFFFFu;
+    static constexpr uint32_t kWaitingWriterOne = 1u << 16;
+    static constexpr uint32_t kWaitingWritersMask = 0x07FFu << 16;
+    // Set while someone holds the upgradable lock (also counted as a reader).
+    static constexpr uint32_t kUpgrader = 1u << 27;
+    // PhaseFair: readers that waited out the last writer may enter.
+    static constexpr uint32_t kReaderTurn = 1u << 28;
+    static constexpr uint32_t kAsyncWaiting = 1u << 29;
+    static constexpr uint32_t kReadersWaiting = 1u << 30;
+    static constexpr uint32_t kWriter = 1u << 31;
+    static constexpr int kSpinLimit = 128;
+
+    std::atomic<uint32_t> state_{0};
+    // PhaseFair: bumped by every write unlock.
+    std::atomic<uint32_t> phase_{0};
+    // Allocated by the first lock_async that has to queue.
+    std::atomic<AsyncQueue*> async_queue_{nullptr};
+#if HASHMAP_ENABLE_STATS
+    LockCounters counters_;
+#endif
+};
+
+extern template class BasicRWLock<WriterPreference>;
+extern template class BasicRWLock<ReaderPreference>;
+extern template class BasicRWLock<PhaseFair>;
+extern template class BasicRWLock<TaskFair>;
+
+#if HASHMAP_HAS_COROUTINES
+// Awaitable returned by BasicRWLock::async_read / async_write. Tries the lock
+// in await_ready; on contention it queues itself and suspends, and is resumed
+// through the executor with the lock already held. await_resume runs fn and
+// releases the lock, also if fn throws.
+template <typename Lock, typename Fn, typename Executor>
+class AsyncLockCall : private AsyncLockWaiter {
+public:
+    AsyncLockCall(Lock& lock, bool writer, Fn fn, Executor executor)
+        : lock(lock), fn(std::move(fn)), executor(std::move(executor)) {
+        this->writer = writer;
+        on_acquired = &AsyncLockCall::resume;
+    }
+
+    bool await_ready() {
+        return lock.try_lock(writer);
+    }
+
+    // Once queued, another thread may resume the coroutine at any time, so
+    // nothing here touches *this after lock_async.
+    bool await_suspend(std::coroutine_handle<> handle) {
+        this->handle = handle;
+        return !lock.lock_async(*this);
+    }
+
+    decltype(auto) await_resume() {
+        struct Release {
+            Lock& lock;
+            bool writer;
+            ~Release() {
+                lock.unlock(writer);
+            }
+        } release{lock, writer};
+        return fn();
+    }
+
 private:
-    size_t readers_, writers_;
-    size_t waiting_readers_, waiting_writers_;
-    pthread_mutex_t lock;
-    pthread_cond_t read_cond, write_cond;
-};
\ No newline at end of file
+    static void resume(AsyncLockWaiter* waiter) {
+        auto* self = static_cast<AsyncLockCall*>(waiter);
+        self->executor(self->handle);
+    }
+
+    Lock& lock;
+    Fn fn;
+    Executor executor;
+    std::coroutine_handle<> handle;
+};
+#endif
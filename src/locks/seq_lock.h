@@ -0,0 +1,66 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+#if defined(__SANITIZE_THREAD__)
+#define SEQLOCK_TSAN 1
+#elif defined(__has_feature)
+#if __has_feature(thread_sanitizer)
+#define SEQLOCK_TSAN 1
+#endif
+#endif
+
+#ifdef SEQLOCK_TSAN
+extern "C" void AnnotateIgnoreReadsBegin(const char* file, int line);
+extern "C" void AnnotateIgnoreReadsEnd(const char* file, int line);
+#endif
+
+// Version counter for optimistic readers. Writers must already be serialized
+// by another lock; they bump the counter to odd before mutating and back to
+// even afterwards. Readers snapshot the counter, read without writing any
+// shared memory, then validate that the counter did not move.
+class SeqLock {
+public:
+    // Wraps the reads between read_begin and read_validate. They race with
+    // the writer on purpose (plain loads of memory the writer is changing)
+    // and their result is thrown away unless validation succeeds, so under
+    // ThreadSanitizer they are excluded from race detection; otherwise this
+    // is a no-op. Code in the scope must not dereference anything a
+    // writer may release, nor act on what it read before validating.
+    class SpeculativeReads {
+    public:
+        SpeculativeReads() {
+#ifdef SEQLOCK_TSAN
+            AnnotateIgnoreReadsBegin(__FILE__, __LINE__);
+#endif
+        }
+        ~SpeculativeReads() {
+#ifdef SEQLOCK_TSAN
+            AnnotateIgnoreReadsEnd(__FILE__, __LINE__);
+#endif
+        }
+        SpeculativeReads(const SpeculativeReads&) = delete;
+        SpeculativeReads& operator=(const SpeculativeReads&) = delete;
+    };
+
+    uint64_t read_begin() const {
+        return version_.load(std::memory_order_acquire);
+    }
+
+    bool read_validate(uint64_t snapshot) const {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return (snapshot & 1) == 0 && version_.load(std::memory_order_relaxed) == snapshot;
+    }
+
+    void write_begin() {
+        version_.store(version_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    void write_end() {
+        version_.store(version_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+private:
+    std::atomic<uint64_t> version_{0};
+};
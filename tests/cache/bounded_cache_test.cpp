@@ -0,0 +1,171 @@
+#include <thread>
+#include <vector>
+#include <random>
+#include <string>
+#include <iostream>
+#include <atomic>
+
+#include "cache/bounded_cache.h"
+
+template <template <typename> class Policy>
+bool test_policy(const char* name) {
+    std::cout << "=== " << name << " ===" << std::endl;
+
+    const size_t capacity = 1024;
+    BoundedCache<int, int, 8, std::hash<int>, Policy> cache(capacity);
+
+    // A small hot set is read constantly while a long scan of cold keys streams through.
+    int hot_hits = 0;
+    int hot_lookups = 0;
+    for (int i = 0; i < 20000; ++i) {
+        cache.insert_kv(100000 + i, i);
+        int hot_key = i % 64;
+        auto result = cache.lookup_k(hot_key);
+        hot_lookups++;
+        if (result) {
+            hot_hits++;
+        } else {
+            cache.insert_kv(hot_key, hot_key);
+        }
+    }
+
+    CacheStats stats = cache.stats();
+    double hot_hit_rate = 100.0 * hot_hits / hot_lookups;
+    std::cout << "Size: " << stats.size << "/" << stats.capacity << std::endl;
+    std::cout << "Hits: " << stats.hits << " Misses: " << stats.misses
+              << " Evictions: " << stats.evictions << std::endl;
+    std::cout << "Hot-set hit rate: " << hot_hit_rate << "%" << std::endl;
+
+    return stats.size <= capacity && stats.weight == stats.size && stats.evictions > 0 &&
+           hot_hit_rate > 90.0 && stats.hits + stats.misses == static_cast<uint64_t>(hot_lookups);
+}
+
+bool test_byte_budget() {
+    std::cout << "=== Byte Budget ===" << std::endl;
+
+    struct StringBytes {
+        size_t operator()(const std::string& key, const std::string& value) const {
+            return key.size() + value.size();
+        }
+    };
+    const size_t budget = 64 * 1024;
+    BoundedCache<std::string, std::string, 4, std::hash<std::string>, S3FifoPolicy, StringBytes> cache(budget);
+
+    for (int i = 0; i < 5000; ++i) {
+        cache.insert_kv("key_" + std::to_string(i), std::string(100, 'x'));
+    }
+    bool deleted = cache.delete_k("key_4999");
+
+    CacheStats stats = cache.stats();
+    std::cout << "Bytes: " << stats.weight << "/" << stats.capacity << " in " << stats.size << " entries"
+              << std::endl;
+    return deleted && stats.weight <= budget && stats.size > 0 && !cache.lookup_k("key_4999");
+}
+
+bool test_weighted_admission() {
+    std::cout << "=== W-TinyLFU with a Byte Budget ===" << std::endl;
+
+    // 100 bytes per entry: the budget holds 200 entries. Between two rounds of
+    // reads of the hot set, 300 one-off keys stream through, which flushes it
+    // out of a plain CLOCK; frequency-based admission has to keep it.
+    struct ValueBytes {
+        size_t operator()(int, const std::string& value) const {
+            return value.size();
+        }
+    };
+    BoundedCache<int, std::string, 1, std::hash<int>, TinyLfuPolicy, ValueBytes> cache(200 * 100);
+
+    int hot_hits = 0;
+    int hot_lookups = 0;
+    int cold = 1000;
+    for (int round = 0; round < 50; ++round) {
+        for (int read = 0; read < 4; ++read) {
+            for (int hot_key = 0; hot_key < 32; ++hot_key) {
+                // Only the first read of a round tells whether the key survived the stream.
+                bool counted = round >= 10 && read == 0;
+                if (cache.lookup_k(hot_key)) {
+                    hot_hits += counted;
+                } else {
+                    cache.insert_kv(hot_key, std::string(100, 'h'));
+                }
+                hot_lookups += counted;
+            }
+        }
+        for (int i = 0; i < 300; ++i) {
+            cache.insert_kv(cold++, std::string(100, 'c'));
+        }
+    }
+
+    CacheStats stats = cache.stats();
+    double hot_hit_rate = 100.0 * hot_hits / hot_lookups;
+    std::cout << "Bytes: " << stats.weight << "/" << stats.capacity << " in " << stats.size << " entries"
+              << ", hot-set hit rate: " << hot_hit_rate << "%" << std::endl;
+    return stats.weight <= stats.capacity && hot_hit_rate > 90.0;
+}
+
+bool test_small_capacity() {
+    std::cout << "=== Capacity Below the Shard Count ===" << std::endl;
+
+    // 64 shards, 10 entries: the shares must add up to 10, not 64.
+    BoundedCache<int, int> tiny(10);
+    BoundedCache<int, int, 8> uneven(1003);
+    for (int i = 0; i < 5000; ++i) {
+        tiny.insert_kv(i, i);
+        uneven.insert_kv(i, i);
+    }
+    CacheStats small = tiny.stats();
+    CacheStats odd = uneven.stats();
+    std::cout << "Size: " << small.size << "/" << small.capacity << ", " << odd.size << "/" << odd.capacity
+              << std::endl;
+    return small.size <= 10 && small.weight <= small.capacity && odd.size <= 1003 && odd.size > 900;
+}
+
+bool test_concurrent() {
+    std::cout << "=== Concurrent Mixed Workload ===" << std::endl;
+
+    BoundedCache<int, int, 16, std::hash<int>, TinyLfuPolicy> cache(512);
+    std::atomic<int> wrong_values{0};
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&cache, &wrong_values, t]() {
+            std::mt19937 gen(t);
+            std::uniform_int_distribution<> key_dis(0, 4000);
+            for (int i = 0; i < 20000; ++i) {
+                int key = key_dis(gen);
+                if (i % 3 == 0) {
+                    cache.insert_kv(key, key * 7);
+                } else if (i % 17 == 0) {
+                    cache.delete_k(key);
+                } else if (auto result = cache.lookup_k(key); result && result.value() != key * 7) {
+                    wrong_values++;
+                }
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    CacheStats stats = cache.stats();
+    std::cout << "Size: " << stats.size << "/" << stats.capacity << " Evictions: " << stats.evictions
+              << std::endl;
+    return wrong_values.load() == 0 && stats.size <= stats.capacity;
+}
+
+int main() {
+    bool ok = test_policy<ClockPolicy>("CLOCK") &&
+              test_policy<S3FifoPolicy>("S3-FIFO") &&
+              test_policy<TinyLfuPolicy>("W-TinyLFU") &&
+              test_byte_budget() &&
+              test_weighted_admission() &&
+              test_small_capacity() &&
+              test_concurrent();
+
+    if (ok) {
+        std::cout << "✅ TEST PASSED" << std::endl;
+        return 0;
+    }
+    std::cout << "❌ TEST FAILED" << std::endl;
+    return 1;
+}
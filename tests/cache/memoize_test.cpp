@@ -0,0 +1,111 @@
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "cache/memoize.h"
+
+static double slow_ratio(const std::string& tick, uint64_t before, uint64_t after, uint32_t change) {
+    return tick.empty() ? 0.0 : static_cast<double>(change) / (after - before);
+}
+
+bool test_multi_arg() {
+    std::cout << "=== Multi-Argument Keys ===" << std::endl;
+
+    Memoize ratio(&slow_ratio);
+    bool values_ok = ratio("AAPL", 1000, 2000, 150) == slow_ratio("AAPL", 1000, 2000, 150) &&
+                     ratio("MSFT", 1500, 2500, 200) == slow_ratio("MSFT", 1500, 2500, 200) &&
+                     ratio("AAPL", 1000, 2000, 150) == slow_ratio("AAPL", 1000, 2000, 150) &&
+                     ratio("AAPL", 1000, 2001, 150) == slow_ratio("AAPL", 1000, 2001, 150);
+
+    MemoizeStats stats = ratio.stats();
+    std::cout << "Hits: " << stats.hits << " Misses: " << stats.misses << " Size: " << stats.size << std::endl;
+    return values_ok && stats.hits == 1 && stats.misses == 3 && stats.size == 3;
+}
+
+bool test_lambda_calls() {
+    std::cout << "=== Lambda Call Counting ===" << std::endl;
+
+    std::atomic<int> calls{0};
+    Memoize add([&calls](int a, int b) {
+        calls++;
+        return a + b;
+    });
+    bool values_ok = true;
+    for (int round = 0; round < 3; ++round) {
+        for (int i = 0; i < 100; ++i) {
+            values_ok &= add(i, 2 * i) == 3 * i;
+        }
+    }
+
+    MemoizeStats stats = add.stats();
+    std::cout << "Calls: " << calls.load() << " Hits: " << stats.hits << " Misses: " << stats.misses << std::endl;
+    bool counted = calls.load() == 100 && stats.hits == 200 && stats.misses == 100 && stats.size == 100;
+
+    add.clear();
+    bool cleared = add.stats().size == 0 && add(0, 0) == 0 && calls.load() == 101;
+    return values_ok && counted && cleared;
+}
+
+bool test_concurrent_single_flight() {
+    std::cout << "=== Concurrent Single Flight ===" << std::endl;
+
+    std::atomic<int> calls{0};
+    Memoize square([&calls](const std::string& name, int x) {
+        calls++;
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        return static_cast<long>(name.size()) * x * x;
+    });
+
+    std::atomic<int> wrong{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; ++t) {
+        threads.emplace_back([&square, &wrong]() {
+            for (int x = 0; x < 4; ++x) {
+                if (square("key", x) != 3L * x * x) {
+                    wrong++;
+                }
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    MemoizeStats stats = square.stats();
+    std::cout << "Calls: " << calls.load() << " Hits: " << stats.hits << " Misses: " << stats.misses << std::endl;
+    return wrong.load() == 0 && calls.load() == 4 && stats.hits + stats.misses == 32 && stats.size == 4;
+}
+
+bool test_composite_hash() {
+    std::cout << "=== Tuple And Pair Hashing ===" << std::endl;
+
+    std::string name = "GOOGL";
+    std::tuple<std::string, int> owned(name, 7);
+    DefaultHash<std::tuple<std::string, int>> tuple_hash;
+    DefaultHash<std::pair<std::string, int>> pair_hash;
+
+    bool refs_match = tuple_hash(owned) == tuple_hash(std::forward_as_tuple(name, 7));
+    bool pair_matches = pair_hash({name, 7}) == tuple_hash(owned);
+    bool differs = tuple_hash(owned) != tuple_hash(std::make_tuple(name, 8)) &&
+                   tuple_hash(std::make_tuple(std::string("ab"), 1)) != tuple_hash(std::make_tuple(std::string("ba"), 1));
+    return refs_match && pair_matches && differs;
+}
+
+int main() {
+    bool ok = test_multi_arg() &&
+              test_lambda_calls() &&
+              test_concurrent_single_flight() &&
+              test_composite_hash();
+
+    if (ok) {
+        std::cout << "✅ TEST PASSED" << std::endl;
+        return 0;
+    }
+    std::cout << "❌ TEST FAILED" << std::endl;
+    return 1;
+}
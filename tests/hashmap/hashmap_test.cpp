@@ -4,9 +4,18 @@
 #include <chrono>
 #include <iostream>
 #include <atomic>
+#include <unordered_map>
 #include <unordered_set>
+#include <stdexcept>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
 
 #include "hashmap/hashmap.h"
+#include "hashmap/left_right_map.h"
+#include "hashmap/lockfree_map.h"
+#include "hashmap/expiry_reaper.h"
+#include "hashmap/string_hash.h"
 
 class HashMapTester {
 public:
@@ -84,6 +93,38 @@ public:
         std::cout << "Successful lookups: " << successful_lookups.load() << std::endl;
     }
 
+    template <template <typename, typename, typename, typename, typename> class Table>
+    bool test_resizing(const char* name) {
+        std::cout << "\n=== Resizing Test (" << name << ") ===" << std::endl;
+
+        HashMap<int, int, 4, std::hash<int>, std::equal_to<int>, Table> map;
+        const int num_keys = 20000;
+        size_t initial_buckets = map.bucket_count();
+
+        for (int i = 0; i < num_keys; ++i) {
+            map.insert_kv(i, i * 2);
+        }
+        size_t grown_buckets = map.bucket_count();
+
+        bool ok = map.size() == num_keys && grown_buckets > initial_buckets;
+        for (int i = 0; i < num_keys; ++i) {
+            auto result = map.lookup_k(i);
+            ok = ok && result.has_value() && result.value() == i * 2;
+        }
+
+        for (int i = 0; i < num_keys; ++i) {
+            ok = ok && map.delete_k(i);
+        }
+        size_t shrunk_buckets = map.bucket_count();
+        // Optimistically read tables keep their arrays for concurrent readers.
+        bool expect_shrink = !decltype(map)::kOptimisticReads;
+        ok = ok && map.size() == 0 && (shrunk_buckets < grown_buckets) == expect_shrink;
+
+        std::cout << "Buckets: " << initial_buckets << " -> " << grown_buckets
+                  << " -> " << shrunk_buckets << std::endl;
+        return ok;
+    }
+
 private:
     void worker_thread(int thread_id, int operations) {
         std::random_device rd;
@@ -176,6 +217,882 @@ private:
     }
 };
 
+bool test_flat_table_concurrent() {
+    std::cout << "\n=== Concurrent FlatTable Test ===" << std::endl;
+
+    HashMap<std::string, int, 16, std::hash<std::string>, std::equal_to<std::string>, FlatTable> map;
+    const int num_threads = 4;
+    const int keys_per_thread = 2000;
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&map, t, keys_per_thread]() {
+            for (int i = 0; i < keys_per_thread; ++i) {
+                map.insert_kv("t" + std::to_string(t) + "_" + std::to_string(i), i);
+            }
+            for (int i = 0; i < keys_per_thread; i += 2) {
+                map.delete_k("t" + std::to_string(t) + "_" + std::to_string(i));
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    bool ok = map.size() == num_threads * keys_per_thread / 2;
+    for (int t = 0; t < num_threads; ++t) {
+        for (int i = 0; i < keys_per_thread; ++i) {
+            auto result = map.lookup_k("t" + std::to_string(t) + "_" + std::to_string(i));
+            ok = ok && (i % 2 == 0 ? !result.has_value() : result.value_or(-1) == i);
+        }
+    }
+    std::cout << "Remaining keys: " << map.size() << std::endl;
+    return ok;
+}
+
+bool test_optimistic_reads() {
+    std::cout << "\n=== Optimistic Read Test ===" << std::endl;
+
+    HashMap<uint32_t, uint64_t, 4, std::hash<uint32_t>, std::equal_to<uint32_t>, FlatTable> map;
+    static_assert(decltype(map)::kOptimisticReads, "FlatTable<uint32_t, uint64_t> should read optimistically");
+
+    const uint32_t num_keys = 5000;
+    std::atomic<bool> done{false};
+    std::atomic<int> torn_reads{0};
+
+    std::vector<std::thread> threads;
+    for (int r = 0; r < 3; ++r) {
+        threads.emplace_back([&, r]() {
+            std::mt19937 gen(r);
+            while (!done.load()) {
+                uint32_t key = gen() % num_keys;
+                auto result = map.lookup_k(key);
+                // Every value written for a key carries the key in its low half.
+                if (result && static_cast<uint32_t>(result.value()) != key) {
+                    torn_reads++;
+                }
+            }
+        });
+    }
+    for (uint64_t round = 1; round <= 5; ++round) {
+        for (uint32_t key = 0; key < num_keys; ++key) {
+            map.insert_kv(key, (round << 32) | key);
+        }
+        for (uint32_t key = 0; key < num_keys; key += 3) {
+            map.delete_k(key);
+        }
+    }
+    done = true;
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    std::cout << "Torn reads: " << torn_reads.load() << std::endl;
+    return torn_reads.load() == 0 && map.lookup_k(1).value_or(0) == ((5ull << 32) | 1);
+}
+
+static_assert(std::is_same_v<DefaultTable<uint64_t, uint64_t, DefaultHash<uint64_t>, std::equal_to<uint64_t>,
+                                          std::allocator<std::pair<const uint64_t, uint64_t>>>,
+                             InlineTable<uint64_t, uint64_t, DefaultHash<uint64_t>, std::equal_to<uint64_t>,
+                                         std::allocator<std::pair<const uint64_t, uint64_t>>>>,
+              "integral keys with POD values should default to InlineTable");
+static_assert(DefaultHash<uint64_t>()(42) == hash_int(42), "the integer mixer should be usable at compile time");
+
+// Random inserts and deletes over a small key range (so runs collide and
+// backward-shift deletion gets exercised), including the empty-marker key,
+// checked against std::unordered_map.
+bool test_inline_table() {
+    std::cout << "\n=== InlineTable Test ===" << std::endl;
+
+    HashMap<uint32_t, uint64_t, 2, std::hash<uint32_t>> map;
+    std::unordered_map<uint32_t, uint64_t> reference;
+    std::mt19937 gen(7);
+    const uint32_t sentinel = InlineTable<uint32_t, uint64_t, std::hash<uint32_t>>::kEmptyKey;
+
+    bool ok = true;
+    for (int i = 0; i < 200000 && ok; ++i) {
+        uint32_t key = gen() % 3000;
+        if (key == 0) {
+            key = sentinel;
+        }
+        switch (gen() % 3) {
+        case 0:
+            map.insert_kv(key, i);
+            reference[key] = i;
+            break;
+        case 1:
+            ok = map.delete_k(key) == (reference.erase(key) == 1);
+            break;
+        default: {
+            auto it = reference.find(key);
+            ok = map.lookup_k(key) == (it == reference.end() ? std::nullopt : std::optional<uint64_t>(it->second));
+        }
+        }
+    }
+    ok = ok && map.size() == reference.size();
+    size_t visited = 0;
+    map.for_each([&](const uint32_t& key, const uint64_t& value) {
+        ok = ok && reference.at(key) == value;
+        ++visited;
+    });
+
+    size_t erased = map.erase_if([](const uint32_t& key, const uint64_t&) { return key % 2 == 1; });
+    size_t odd = 0;
+    for (const auto& [key, value] : reference) {
+        odd += key % 2;
+    }
+    ok = ok && visited == reference.size() && erased == odd && map.size() == reference.size() - odd;
+    ok = ok && map.lookup_k(sentinel).has_value() == (reference.count(sentinel) == 1 && sentinel % 2 == 0);
+    std::cout << "Entries: " << reference.size() << ", erased odd keys: " << erased << std::endl;
+    return ok;
+}
+
+// Counters per symbol: hot keys are bumped from many threads with fetch_add
+// (read lock + atomic add), upsert and compare_exchange; no increment may be
+// lost, including the ones that race to create a key.
+template <template <typename, typename, typename, typename, typename> class Table>
+bool test_atomic_updates(const char* name) {
+    std::cout << "\n=== Atomic Update Test (" << name << ") ===" << std::endl;
+
+    HashMap<uint64_t, uint64_t, 4, DefaultHash<uint64_t>, std::equal_to<uint64_t>, Table> counters;
+    HashMap<uint64_t, double, 4, DefaultHash<uint64_t>, std::equal_to<uint64_t>, Table> sums;
+    const int num_threads = 8;
+    const int iterations = 20000;
+    const uint64_t keys = 16;
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&, t]() {
+            for (int i = 0; i < iterations; ++i) {
+                uint64_t key = (i + t) % keys;
+                switch (i % 4) {
+                case 0:
+                case 1:
+                    counters.fetch_add(key, 1);
+                    break;
+                case 2:
+                    counters.upsert(key, 1, [](uint64_t& v) { ++v; });
+                    break;
+                default: {
+                    uint64_t expected = counters.lookup_k(key).value_or(0);
+                    while (!counters.compare_exchange(key, expected, expected + 1)) {
+                        if (!counters.lookup_k(key)) {
+                            counters.upsert(key, 0, [](uint64_t&) {});
+                            expected = 0;
+                        }
+                    }
+                }
+                }
+                sums.fetch_add(key, 0.5);
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    uint64_t total = 0;
+    double sum_total = 0;
+    counters.for_each([&](const uint64_t&, const uint64_t& v) { total += v; });
+    sums.for_each([&](const uint64_t&, const double& v) { sum_total += v; });
+
+    bool ok = total == uint64_t(num_threads) * iterations && sum_total == num_threads * iterations * 0.5;
+    ok = ok && counters.compute_if_present(3, [](uint64_t& v) { v = 100; }) && counters.lookup_k(3) == 100u;
+    ok = ok && !counters.compute_if_present(keys + 1, [](uint64_t& v) { v = 1; }) && !counters.lookup_k(keys + 1);
+    uint64_t expected = 7;
+    ok = ok && !counters.compare_exchange(3, expected, 8) && expected == 100;
+    ok = ok && counters.fetch_add(keys + 2, 5) == 0 && counters.fetch_add(keys + 2, 5) == 5;
+    std::cout << "Counted " << total << " increments, summed " << sum_total << std::endl;
+    return ok;
+}
+
+bool test_get_or_compute_single_flight() {
+    std::cout << "\n=== get_or_compute Single-Flight Test ===" << std::endl;
+
+    HashMap<std::string, int, 8> map;
+    std::atomic<int> computations{0};
+    std::atomic<int> wrong_results{0};
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; ++t) {
+        threads.emplace_back([&]() {
+            int value = map.get_or_compute("expensive", [&](const std::string& key) {
+                computations++;
+                std::this_thread::sleep_for(std::chrono::milliseconds(50));
+                return static_cast<int>(key.size());
+            });
+            if (value != 9) {
+                wrong_results++;
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    bool threw = false;
+    try {
+        map.get_or_compute("failing", [](const std::string&) -> int {
+            throw std::runtime_error("computation failed");
+        });
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    int retried = map.get_or_compute("failing", [](const std::string&) { return 1; });
+
+    std::cout << "Computations for 8 concurrent misses: " << computations.load() << std::endl;
+    return computations.load() == 1 && wrong_results.load() == 0 && threw && retried == 1 &&
+           !map.lookup_k("missing").has_value();
+}
+
+// Key equality that, once armed, holds each comparison against "hot" until a
+// second thread is comparing too (or a second has passed), recording how
+// many ran at once.
+struct RendezvousEqual {
+    static inline std::atomic<bool> armed{false};
+    static inline std::atomic<int> inside{0};
+    static inline std::atomic<int> most{0};
+
+    bool operator()(const std::string& a, const std::string& b) const {
+        if (armed.load() && a == "hot") {
+            int now = ++inside;
+            int seen = most.load();
+            while (now > seen && !most.compare_exchange_weak(seen, now)) {
+            }
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+            while (most.load() < 2 && std::chrono::steady_clock::now() < deadline) {
+                std::this_thread::yield();
+            }
+            --inside;
+        }
+        return a == b;
+    }
+};
+
+bool test_get_or_compute_parallel_hits() {
+    std::cout << "\n=== get_or_compute Parallel Hits Test ===" << std::endl;
+
+    // One shard on a locking engine: two hits on the same key must be able to
+    // run at the same time rather than queue on the upgradable lock.
+    HashMap<std::string, int, 1, DefaultHash<std::string>, RendezvousEqual> map;
+    map.insert_kv("hot", 1);
+    RendezvousEqual::armed = true;
+    std::atomic<int> wrong{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 2; ++t) {
+        threads.emplace_back([&]() {
+            if (map.get_or_compute("hot", [](const std::string&) { return 2; }) != 1) {
+                wrong++;
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    RendezvousEqual::armed = false;
+
+    std::cout << "Concurrent hits observed: " << RendezvousEqual::most.load() << std::endl;
+    return RendezvousEqual::most.load() == 2 && wrong.load() == 0;
+}
+
+bool test_ttl_expiry() {
+    std::cout << "\n=== TTL Expiry Test ===" << std::endl;
+
+    using namespace std::chrono_literals;
+    HashMap<std::string, int, 8> map;
+
+    for (int i = 0; i < 1000; ++i) {
+        map.insert_kv("short_" + std::to_string(i), i, 30ms);
+    }
+    map.insert_kv("forever", 1);
+    map.insert_kv("renewed", 2, 30ms);
+    map.insert_kv("renewed", 3);  // overwriting without a TTL clears the deadline
+
+    bool ok = map.lookup_k("short_7").value_or(-1) == 7;
+    std::this_thread::sleep_for(60ms);
+
+    ok = ok && !map.lookup_k("short_7").has_value() && !map.delete_k("short_8");
+    ok = ok && map.lookup_k("forever").value_or(-1) == 1 && map.lookup_k("renewed").value_or(-1) == 3;
+
+    size_t reaped = map.reap_expired(16);
+    std::cout << "Reaped " << reaped << " expired entries, " << map.size() << " left" << std::endl;
+    ok = ok && reaped == 999 && map.size() == 2;
+
+    {
+        ExpiryReaper<decltype(map)> reaper(map, 5ms);
+        for (int i = 0; i < 100; ++i) {
+            map.insert_kv("reaped_" + std::to_string(i), i, 10ms);
+        }
+        // Polled rather than slept on, so a loaded machine only makes this slower.
+        auto deadline = std::chrono::steady_clock::now() + 10s;
+        while (reaper.reaped() < 100 && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(5ms);
+        }
+        std::cout << "Background reaper removed " << reaper.reaped() << " entries" << std::endl;
+        ok = ok && reaper.reaped() == 100;
+    }
+    return ok && map.size() == 2;
+}
+
+template <template <typename, typename, typename, typename, typename> class Table>
+bool test_batch_operations(const char* name) {
+    std::cout << "\n=== Batch Operations Test (" << name << ") ===" << std::endl;
+
+    HashMap<uint64_t, uint64_t, 16, std::hash<uint64_t>, std::equal_to<uint64_t>, Table> map;
+    const size_t batch = 500;
+
+    std::vector<uint64_t> keys(batch);
+    std::vector<uint64_t> values(batch);
+    for (size_t i = 0; i < batch; ++i) {
+        keys[i] = i * 3;
+        values[i] = i * 7;
+    }
+    map.multi_insert(keys.data(), values.data(), batch);
+
+    // Every other probe misses: odd multiples of 3 plus one were never inserted.
+    std::vector<uint64_t> probes(2 * batch);
+    for (size_t i = 0; i < batch; ++i) {
+        probes[2 * i] = keys[batch - 1 - i];
+        probes[2 * i + 1] = keys[i] + 1;
+    }
+    std::vector<std::optional<uint64_t>> results(probes.size());
+    map.multi_get(probes.data(), probes.size(), results.data());
+
+    bool ok = map.size() == batch;
+    for (size_t i = 0; i < batch; ++i) {
+        ok = ok && results[2 * i] == values[batch - 1 - i] && !results[2 * i + 1].has_value();
+        ok = ok && map.lookup_k(keys[i]) == values[i];
+    }
+    std::cout << "Batched " << batch << " inserts and " << probes.size() << " lookups" << std::endl;
+    return ok;
+}
+
+// Value type that counts how often it is copied.
+struct CopyCounted {
+    static inline std::atomic<int> copies{0};
+
+    explicit CopyCounted(size_t n, int fill) : payload(n, fill) {}
+    CopyCounted(const CopyCounted& other) : payload(other.payload) { copies++; }
+    CopyCounted(CopyCounted&&) = default;
+    CopyCounted& operator=(const CopyCounted& other) {
+        payload = other.payload;
+        copies++;
+        return *this;
+    }
+    CopyCounted& operator=(CopyCounted&&) = default;
+
+    std::vector<int> payload;
+};
+
+bool test_zero_copy_access() {
+    std::cout << "\n=== Zero-Copy Access Test ===" << std::endl;
+
+    HashMap<std::string, CopyCounted, 8, StringHash, std::equal_to<>> map;
+    static_assert(decltype(map)::kHeterogeneous, "StringHash with std::equal_to<> should be transparent");
+
+    bool ok = map.try_emplace("alpha", 1000, 1);
+    ok = ok && !map.try_emplace("alpha", 5, 5);  // existing entry is left alone
+    map.insert_kv(std::string("beta"), CopyCounted(2000, 2));
+
+    std::string_view alpha_view = "alpha";
+    size_t alpha_size = 0;
+    ok = ok && map.visit(alpha_view, [&](const CopyCounted& v) { alpha_size = v.payload.size(); });
+    ok = ok && !map.visit(std::string_view("gamma"), [](const CopyCounted&) {});
+    int copies_before_lookup = CopyCounted::copies.load();
+
+    auto beta = map.lookup_k(std::string_view("beta"));  // one copy out of the map
+    ok = ok && beta && beta->payload.size() == 2000 && beta->payload[0] == 2;
+    ok = ok && map.delete_k(std::string_view("beta")) && !map.lookup_k("beta");
+
+    std::cout << "Copies while inserting/visiting: " << copies_before_lookup
+              << ", after lookup: " << CopyCounted::copies.load() << std::endl;
+    return ok && alpha_size == 1000 && copies_before_lookup == 0 && CopyCounted::copies.load() == 1;
+}
+
+template <template <typename, typename, typename, typename, typename> class Table>
+bool test_iteration(const std::string& name) {
+    std::cout << "\n=== Iteration and erase_if Test (" << name << ") ===" << std::endl;
+
+    HashMap<int, int, 16, std::hash<int>, std::equal_to<int>, Table> map;
+    const int n = 10000;
+    for (int i = 0; i < n; ++i) {
+        map.insert_kv(i, i * 2);
+    }
+    map.insert_kv(-1, 7, std::chrono::nanoseconds(1));  // expired: never visited
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    long long sum = 0;
+    size_t seen = 0;
+    map.for_each([&](const int& key, const int& value) {
+        sum += value - 2 * key;
+        ++seen;
+    });
+
+    std::atomic<long long> parallel_sum{0};
+    std::atomic<size_t> parallel_seen{0};
+    map.parallel_for_each([&](const int&, const int& value) {
+        parallel_sum += value;
+        parallel_seen++;
+    }, 4);
+
+    // Readers keep going while odd keys are pruned shard by shard.
+    std::atomic<bool> stop{false};
+    std::atomic<bool> lost_even{false};
+    std::thread reader([&]() {
+        for (int i = 0; !stop; i = (i + 2) % n) {
+            if (!map.lookup_k(i)) {
+                lost_even = true;
+            }
+        }
+    });
+    size_t erased = map.erase_if([](const int& key, const int&) { return key % 2 != 0; });
+    stop = true;
+    reader.join();
+
+    bool ok = sum == 0 && seen == n && parallel_seen == n && parallel_sum == (long long)n * (n - 1);
+    ok = ok && erased == n / 2 && map.size() == n / 2 && !lost_even;
+    for (int i = 0; i < n && ok; ++i) {
+        ok = map.lookup_k(i).has_value() == (i % 2 == 0);
+    }
+    std::cout << "Visited " << seen << " entries (" << parallel_seen << " in parallel), erased " << erased
+              << ", " << map.bucket_count() << " buckets left" << std::endl;
+    return ok;
+}
+
+template <template <typename, typename, typename, typename, typename> class Table>
+bool test_slab_allocator(const std::string& name, bool expect_release) {
+    std::cout << "\n=== Slab Allocator and shrink_to_fit Test (" << name << ") ===" << std::endl;
+
+    using Map = HashMap<std::string, std::string, 8, DefaultHash<std::string>, std::equal_to<std::string>, Table,
+                        SlabAllocator<std::pair<const std::string, std::string>>>;
+    Map map;
+    const int n = 20000;
+
+    // Churn from several threads; every shard allocates from its own arena.
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&map, t]() {
+            for (int i = t; i < n; i += 4) {
+                map.insert_kv("key_" + std::to_string(i), std::string(40, 'a' + i % 26));
+                if (i % 3 == 0) {
+                    map.delete_k("key_" + std::to_string(i));
+                }
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    bool ok = map.size() == n - (n + 2) / 3;
+    for (int i = 0; i < n && ok; ++i) {
+        auto value = map.lookup_k("key_" + std::to_string(i));
+        ok = (i % 3 == 0) ? !value : (value && *value == std::string(40, 'a' + i % 26));
+    }
+
+    size_t buckets_before = map.bucket_count();
+    map.erase_if([](const std::string& key, const std::string&) { return key.back() != '7'; });
+    size_t released = map.shrink_to_fit();
+    size_t remaining = map.size();
+    for (int i = 7; i < n && ok; i += 10) {
+        ok = map.lookup_k("key_" + std::to_string(i)).has_value() == (i % 3 != 0);
+    }
+    map.insert_kv("after_shrink", "still works");
+    ok = ok && map.lookup_k("after_shrink") == std::string("still works");
+    size_t buckets_after = map.bucket_count();
+
+    // Chunks go back to the system once every block in them is free. Chained
+    // nodes fill many chunks; flat tables keep their (minimum size) array in
+    // the one chunk a shard ever needed, everything bigger bypasses the arena.
+    map.erase_if([](const std::string&, const std::string&) { return true; });
+    released += map.shrink_to_fit();
+
+    std::cout << "Buckets " << buckets_before << " -> " << buckets_after << ", " << remaining
+              << " entries left, " << released / 1024 << " KiB returned by arenas" << std::endl;
+    return ok && buckets_after < buckets_before && (released > 0 || !expect_release) && map.size() == 0;
+}
+
+bool test_lockfree_map() {
+    std::cout << "\n=== LockFreeHashMap Test ===" << std::endl;
+
+    LockFreeHashMap<int, std::string> map;
+    const int num_threads = 8;
+    const int keys_per_thread = 5000;
+
+    // Each thread owns a key range: insert, overwrite, then delete every
+    // third key, while readers probe all ranges concurrently.
+    std::atomic<bool> done{false};
+    std::atomic<int> bad_reads{0};
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 2; ++r) {
+        readers.emplace_back([&, r]() {
+            std::mt19937 gen(r);
+            while (!done.load()) {
+                int key = gen() % (num_threads * keys_per_thread);
+                auto value = map.lookup_k(key);
+                if (value && *value != "v" + std::to_string(key) && *value != "w" + std::to_string(key)) {
+                    bad_reads++;
+                }
+            }
+        });
+    }
+    std::vector<std::thread> writers;
+    for (int t = 0; t < num_threads; ++t) {
+        writers.emplace_back([&map, t]() {
+            int base = t * keys_per_thread;
+            for (int i = base; i < base + keys_per_thread; ++i) {
+                map.insert_kv(i, "v" + std::to_string(i));
+            }
+            for (int i = base; i < base + keys_per_thread; ++i) {
+                map.insert_kv(i, "w" + std::to_string(i));
+                if (i % 3 == 0) {
+                    map.delete_k(i);
+                }
+            }
+        });
+    }
+    for (auto& t : writers) {
+        t.join();
+    }
+    done = true;
+    for (auto& t : readers) {
+        t.join();
+    }
+
+    bool ok = bad_reads.load() == 0;
+    int expected = 0;
+    for (int i = 0; i < num_threads * keys_per_thread; ++i) {
+        auto value = map.lookup_k(i);
+        if (i % 3 == 0) {
+            ok = ok && !value;
+        } else {
+            ok = ok && value == "w" + std::to_string(i);
+            ++expected;
+        }
+    }
+    size_t walked = 0;
+    map.for_each([&](const int&, const std::string&) { ++walked; });
+    ok = ok && map.size() == static_cast<size_t>(expected) && walked == map.size() && !map.delete_k(0);
+
+    std::cout << map.size() << " entries in " << map.bucket_count() << " buckets, " << bad_reads.load()
+              << " torn reads" << std::endl;
+    return ok && map.bucket_count() > LockFreeHashMap<int, std::string>::kFirstSegment;
+}
+
+template <template <typename, typename, typename, typename, typename> class Table>
+bool test_left_right_map(const std::string& name) {
+    std::cout << "\n=== LeftRightMap Test (" << name << ") ===" << std::endl;
+
+    LeftRightMap<int, int, DefaultHash<int>, std::equal_to<int>, Table> map;
+    const int num_keys = 1000;
+
+    // Every write keeps the invariant value == key * generation, so a reader
+    // seeing a mismatch would have observed a half-applied copy.
+    std::atomic<bool> done{false};
+    std::atomic<int> bad_reads{0};
+    std::atomic<long> reads{0};
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 4; ++r) {
+        readers.emplace_back([&, r]() {
+            std::mt19937 gen(r);
+            while (!done.load()) {
+                int key = 1 + gen() % num_keys;
+                auto value = map.lookup_k(key);
+                if (value && *value % key != 0) {
+                    bad_reads++;
+                }
+                reads++;
+            }
+        });
+    }
+    while (reads.load() == 0) {
+        std::this_thread::yield();
+    }
+    std::vector<int> keys(num_keys), values(num_keys);
+    for (int generation = 1; generation <= 20; ++generation) {
+        for (int i = 0; i < num_keys; ++i) {
+            keys[i] = i + 1;
+            values[i] = (i + 1) * generation;
+        }
+        map.multi_insert(keys.data(), values.data(), num_keys);
+        map.insert_kv(generation, generation * generation);
+        map.delete_k(num_keys - generation);
+    }
+    done = true;
+    for (auto& t : readers) {
+        t.join();
+    }
+
+    bool ok = bad_reads.load() == 0 && map.size() == static_cast<size_t>(num_keys - 1);
+    ok = ok && !map.lookup_k(num_keys - 20) && map.lookup_k(7) == 7 * 20 && !map.delete_k(num_keys - 20);
+    int seen = 0;
+    map.for_each([&](const int& key, const int& value) { seen += value == key * 20; });
+    ok = ok && seen == num_keys - 1;
+    ok = ok && map.visit(3, [](const int& value) { return value; }) && !map.visit(-1, [](const int&) {});
+
+    std::cout << reads.load() << " reads during 60 writes, " << bad_reads.load() << " inconsistent" << std::endl;
+    return ok;
+}
+
+bool test_snapshot_round_trip() {
+    std::cout << "\n=== Snapshot Save/Load Test ===" << std::endl;
+
+    std::string path = (std::filesystem::temp_directory_path() / "hashmap_test_snapshot.bin").string();
+    HashMap<std::string, uint64_t, 16> source;
+    for (uint64_t i = 0; i < 5000; ++i) {
+        source.insert_kv("key_" + std::to_string(i), i * 3);
+    }
+    source.insert_kv("short_lived", 1, std::chrono::milliseconds(30));
+    source.insert_kv("long_lived", 2, std::chrono::hours(1));
+    source.insert_kv("already_expired", 3, std::chrono::nanoseconds(1));
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    size_t saved = source.save_snapshot(path);
+
+    // Different shard count and engine: every record is rehashed on load.
+    HashMap<std::string, uint64_t, 7, std::hash<std::string>, std::equal_to<std::string>, FlatTable> restored;
+    restored.insert_kv("key_0", 999);
+    size_t loaded = restored.load_snapshot(path, 4);
+
+    bool ok = saved == 5002 && loaded == 5002 && restored.size() == 5002;
+    for (uint64_t i = 0; i < 5000 && ok; ++i) {
+        ok = restored.lookup_k("key_" + std::to_string(i)) == i * 3;
+    }
+    ok = ok && restored.lookup_k("long_lived") == 2u && !restored.lookup_k("already_expired");
+    ok = ok && restored.lookup_k("short_lived") == 1u;
+    std::this_thread::sleep_for(std::chrono::milliseconds(40));
+    ok = ok && !restored.lookup_k("short_lived");
+
+    // A truncated file is rejected.
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 8);
+    bool rejected = false;
+    try {
+        HashMap<std::string, uint64_t, 16>().load_snapshot(path);
+    } catch (const std::runtime_error&) {
+        rejected = true;
+    }
+    std::remove(path.c_str());
+
+    std::cout << "Saved " << saved << ", loaded " << loaded << ", truncated file rejected: " << rejected
+              << std::endl;
+    return ok && rejected;
+}
+
+bool test_change_feed() {
+    std::cout << "\n=== Change Feed Test ===" << std::endl;
+
+    using Map = HashMap<std::string, uint64_t, 8>;
+    using Event = ChangeEvent<std::string, uint64_t>;
+    Map map;
+    map.insert_kv("before", 1);  // not fed
+    ChangeRing ring(1 << 16);
+    map.set_change_feed(&ring);
+
+    map.insert_kv("a", 1);
+    map.insert_kv("a", 2);
+    map.try_emplace("b", 5);
+    map.try_emplace("b", 6);  // present: no record
+    map.upsert("a", 0, [](uint64_t& v) { v += 10; });
+    map.fetch_add("c", 3);
+    map.fetch_add("c", 4);
+    uint64_t expected = 7;
+    map.compare_exchange("c", expected, 70);
+    map.delete_k("a");
+    map.delete_k("missing");  // no record
+    map.insert_kv("short", 9, std::chrono::nanoseconds(1));
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    map.reap_expired();
+    map.erase_if([](const std::string& key, uint64_t) { return key == "b"; });
+
+    std::vector<std::string> log;
+    ring.drain<std::string, uint64_t>([&](const Event& e) {
+        log.push_back(std::to_string(static_cast<int>(e.op)) + e.key +
+                      (e.value ? "=" + std::to_string(*e.value) : "") + (e.ttl_ns ? "~" : ""));
+    });
+    std::vector<std::string> want = {"1a=1", "2a=2", "1b=5", "2a=12", "1c=3", "2c=7", "2c=70",
+                                     "3a", "1short=9~", "4short", "3b"};
+    bool ordered = log == want;
+
+    // Many writers, a Block ring far smaller than the traffic and a consumer
+    // replaying into a mirror: the mirror must end up equal to the map.
+    HashMap<uint64_t, uint64_t, 16> source;
+    ChangeRing small(4096, ChangeRing::Overflow::Block);
+    source.set_change_feed(&small);
+    std::unordered_map<uint64_t, uint64_t> mirror;
+    std::atomic<bool> done{false};
+    std::thread consumer([&]() {
+        auto apply = [&](const ChangeEvent<uint64_t, uint64_t>& e) {
+            if (e.value) {
+                mirror[e.key] = *e.value;
+            } else {
+                mirror.erase(e.key);
+            }
+        };
+        while (!done.load()) {
+            if (small.drain<uint64_t, uint64_t>(apply, 64) == 0) {
+                std::this_thread::yield();
+            }
+        }
+        small.drain<uint64_t, uint64_t>(apply);
+    });
+    std::vector<std::thread> writers;
+    for (int t = 0; t < 4; ++t) {
+        writers.emplace_back([&source, t]() {
+            std::mt19937 gen(t);
+            std::uniform_int_distribution<uint64_t> key_dis(0, 499);
+            for (int i = 0; i < 20000; ++i) {
+                uint64_t key = key_dis(gen);
+                if (i % 5 == 0) {
+                    source.delete_k(key);
+                } else if (i % 5 == 1) {
+                    source.fetch_add(key, 1);
+                } else {
+                    source.insert_kv(key, key * 100 + t);
+                }
+            }
+        });
+    }
+    for (auto& w : writers) {
+        w.join();
+    }
+    done = true;
+    consumer.join();
+    bool mirrored = mirror.size() == source.size() && small.dropped() == 0;
+    source.for_each([&](uint64_t key, uint64_t value) {
+        auto it = mirror.find(key);
+        mirrored = mirrored && it != mirror.end() && it->second == value;
+    });
+
+    // Without a consumer a Drop ring fills up and counts what it discards.
+    HashMap<uint64_t, uint64_t, 4> lossy;
+    ChangeRing tiny(4096);
+    lossy.set_change_feed(&tiny);
+    for (uint64_t i = 0; i < 1000; ++i) {
+        lossy.insert_kv(i, i);
+    }
+    size_t kept = tiny.drain<uint64_t, uint64_t>([](const ChangeEvent<uint64_t, uint64_t>&) {});
+    bool counted = tiny.dropped() > 0 && kept + tiny.dropped() == 1000;
+
+    // A file-backed ring attached twice, as a producer and a consumer process would.
+    std::string path = (std::filesystem::temp_directory_path() / "hashmap_test_feed.bin").string();
+    std::remove(path.c_str());
+    size_t shared_seen = 0;
+    {
+        ChangeRing producer(path, 1 << 16);
+        ChangeRing reader(path, 0);
+        Map fed;
+        fed.set_change_feed(&producer);
+        for (uint64_t i = 0; i < 100; ++i) {
+            fed.insert_kv("key_" + std::to_string(i), i);
+        }
+        fed.set_change_feed(nullptr);
+        fed.insert_kv("after", 1);  // not fed
+        reader.drain<std::string, uint64_t>([&](const Event& e) {
+            shared_seen += e.op == ChangeOp::Insert && e.key == "key_" + std::to_string(*e.value);
+        });
+    }
+    std::remove(path.c_str());
+
+    std::cout << "Ordered: " << ordered << ", mirrored " << mirror.size() << " keys: " << mirrored
+              << ", dropped " << tiny.dropped() << " of 1000, shared file records: " << shared_seen << std::endl;
+    return ordered && mirrored && counted && shared_seen == 100;
+}
+
+bool test_hot_tier() {
+    std::cout << "\n=== Hot Tier Test ===" << std::endl;
+
+    HashMap<std::string, std::string, 8> map;
+    for (int i = 0; i < 100; ++i) {
+        map.insert_kv("key" + std::to_string(i), "value" + std::to_string(i));
+    }
+    bool enabled = map.enable_hot_tier(1) && !map.enable_hot_tier(1);
+    auto heat = [&map](const std::string& key, int lookups) {
+        for (int i = 0; i < lookups; ++i) {
+            map.lookup_k(key);
+        }
+    };
+
+    heat("key1", 1000);
+    bool promoted = map.hot_keys() == std::vector<std::string>{"key1"} && map.hot_tier_stats().hits > 0;
+    // Writes go through to the tier; deletes drop the key from it.
+    map.insert_kv("key1", "fresh");
+    map.upsert("key1", "", [](std::string& v) { v += "!"; });
+    bool written = map.lookup_k("key1") == "fresh!";
+    map.delete_k("key1");
+    bool deleted = !map.lookup_k("key1") && map.hot_keys().empty();
+
+    // A hotter key takes the only place from a cooler one.
+    heat("key2", 500);
+    heat("key3", 4000);
+    HotTierStats stats = map.hot_tier_stats();
+    bool replaced = map.hot_keys() == std::vector<std::string>{"key3"} && stats.demotions >= 2;
+
+    // Promoted entries keep their TTL.
+    map.insert_kv("key3", "short", std::chrono::milliseconds(20));
+    bool short_lived = map.lookup_k("key3") == "short";
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    bool expired = !map.lookup_k("key3");
+
+    // More members than the membership filter has bits: every key that gets
+    // hot must be promoted, including those sharing a bit with a member.
+    HashMap<uint64_t, uint64_t, 16> many;
+    many.enable_hot_tier(2000, 4);
+    for (uint64_t key = 0; key < 1100; ++key) {
+        many.insert_kv(key, key);
+        for (int i = 0; i < 200; ++i) {
+            many.lookup_k(key);
+        }
+    }
+    bool all_promoted = many.hot_keys().size() == 1100 && many.lookup_k(1099) == 1099u;
+
+    // Readers of a hot counter must never see it go backwards while writers
+    // bump it through fetch_add, upsert and insert_kv.
+    HashMap<uint64_t, uint64_t, 4> counters;
+    counters.insert_kv(7, 0);
+    counters.enable_hot_tier(4, 2);
+    for (int i = 0; i < 1000; ++i) {
+        counters.lookup_k(7);
+    }
+    bool counter_hot = !counters.hot_keys().empty();
+    std::atomic<bool> done{false};
+    std::atomic<int> backwards{0};
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; ++t) {
+        readers.emplace_back([&]() {
+            uint64_t last = 0;
+            while (!done.load()) {
+                uint64_t v = counters.lookup_k(7).value_or(0);
+                if (v < last) {
+                    backwards++;
+                }
+                last = v;
+            }
+        });
+    }
+    std::vector<std::thread> writers;
+    for (int t = 0; t < 2; ++t) {
+        writers.emplace_back([&counters]() {
+            for (int i = 0; i < 5000; ++i) {
+                counters.fetch_add(7, 1);
+                counters.upsert(7, 0, [](uint64_t& v) { v += 1; });
+            }
+        });
+    }
+    for (auto& t : writers) {
+        t.join();
+    }
+    done = true;
+    for (auto& t : readers) {
+        t.join();
+    }
+    bool coherent = backwards.load() == 0 && counters.lookup_k(7) == 20000u;
+
+    std::cout << "Promotions: " << stats.promotions << ", demotions: " << stats.demotions
+              << ", tier hits: " << stats.hits << ", counter tier hits: " << counters.hot_tier_stats().hits
+              << std::endl;
+    return enabled && promoted && written && deleted && replaced && short_lived && expired && all_promoted &&
+           counter_hot && coherent;
+}
+
 int main() {
     try {
         HashMapTester tester;
@@ -189,6 +1106,100 @@ int main() {
         tester.successful_deletes = 0;
         
         tester.test_reader_writer_scenario();
+
+        if (!tester.test_resizing<ChainedTable>("ChainedTable") ||
+            !tester.test_resizing<FlatTable>("FlatTable") ||
+            !tester.test_resizing<InlineTable>("InlineTable")) {
+            std::cerr << "❌ Resizing test failed" << std::endl;
+            return 1;
+        }
+
+        if (!test_flat_table_concurrent()) {
+            std::cerr << "❌ FlatTable concurrent test failed" << std::endl;
+            return 1;
+        }
+
+        if (!test_optimistic_reads()) {
+            std::cerr << "❌ Optimistic read test failed" << std::endl;
+            return 1;
+        }
+
+        if (!test_inline_table()) {
+            std::cerr << "❌ InlineTable test failed" << std::endl;
+            return 1;
+        }
+
+        if (!test_atomic_updates<ChainedTable>("ChainedTable") || !test_atomic_updates<FlatTable>("FlatTable") ||
+            !test_atomic_updates<InlineTable>("InlineTable")) {
+            std::cerr << "❌ Atomic update test failed" << std::endl;
+            return 1;
+        }
+
+        if (!test_get_or_compute_single_flight()) {
+            std::cerr << "❌ get_or_compute single-flight test failed" << std::endl;
+            return 1;
+        }
+
+        if (!test_get_or_compute_parallel_hits()) {
+            std::cerr << "❌ get_or_compute parallel hits test failed" << std::endl;
+            return 1;
+        }
+
+        if (!test_batch_operations<ChainedTable>("ChainedTable") ||
+            !test_batch_operations<FlatTable>("FlatTable") ||
+            !test_batch_operations<InlineTable>("InlineTable")) {
+            std::cerr << "❌ Batch operations test failed" << std::endl;
+            return 1;
+        }
+
+        if (!test_zero_copy_access()) {
+            std::cerr << "❌ Zero-copy access test failed" << std::endl;
+            return 1;
+        }
+
+        if (!test_ttl_expiry()) {
+            std::cerr << "❌ TTL expiry test failed" << std::endl;
+            return 1;
+        }
+
+        if (!test_iteration<ChainedTable>("ChainedTable") || !test_iteration<FlatTable>("FlatTable") ||
+            !test_iteration<InlineTable>("InlineTable")) {
+            std::cerr << "❌ Iteration test failed" << std::endl;
+            return 1;
+        }
+
+        if (!test_slab_allocator<ChainedTable>("ChainedTable", true) ||
+            !test_slab_allocator<FlatTable>("FlatTable", false)) {
+            std::cerr << "❌ Slab allocator test failed" << std::endl;
+            return 1;
+        }
+
+        if (!test_lockfree_map()) {
+            std::cerr << "❌ Lock-free map test failed" << std::endl;
+            return 1;
+        }
+
+        if (!test_left_right_map<ChainedTable>("ChainedTable") ||
+            !test_left_right_map<FlatTable>("FlatTable") ||
+            !test_left_right_map<InlineTable>("InlineTable")) {
+            std::cerr << "❌ Left-right map test failed" << std::endl;
+            return 1;
+        }
+
+        if (!test_snapshot_round_trip()) {
+            std::cerr << "❌ Snapshot test failed" << std::endl;
+            return 1;
+        }
+
+        if (!test_change_feed()) {
+            std::cerr << "❌ Change feed test failed" << std::endl;
+            return 1;
+        }
+
+        if (!test_hot_tier()) {
+            std::cerr << "❌ Hot tier test failed" << std::endl;
+            return 1;
+        }
         
         std::cout << "\n✅ All tests completed successfully!" << std::endl;
         return 0;
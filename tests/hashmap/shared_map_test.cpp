@@ -0,0 +1,250 @@
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <csignal>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "hashmap/shared_map.h"
+
+using Map = SharedHashMap<uint64_t, uint64_t, 8>;
+
+static std::string segment_name(const char* what) {
+    return "/hashmap_test_" + std::string(what) + "_" + std::to_string(::getpid());
+}
+
+// Runs fn in a child process; returns its exit status (-1 if killed).
+template <typename Fn>
+int run_child(Fn&& fn) {
+    pid_t pid = ::fork();
+    if (pid == 0) {
+        ::_exit(fn() ? 0 : 1);
+    }
+    int status = 0;
+    ::waitpid(pid, &status, 0);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+bool test_basic() {
+    std::cout << "=== Basic Operations ===" << std::endl;
+
+    std::string name = segment_name("basic");
+    Map map(name, 1000);
+    bool ok = map.insert_kv(1, 10) && map.insert_kv(2, 20) && map.insert_kv(1, 11);
+    ok = ok && map.lookup_k(1) == 11u && map.lookup_k(2) == 20u && !map.lookup_k(3) && map.size() == 2;
+    ok = ok && map.delete_k(2) && !map.delete_k(2) && !map.lookup_k(2) && map.size() == 1;
+    ok = ok && map.upsert(1, 0, [](uint64_t& v) { v *= 2; }) && map.lookup_k(1) == 22u;
+    ok = ok && map.get_or_compute(5, [](uint64_t k) { return k * 7; }) == 35u && map.lookup_k(5) == 35u;
+
+    // Fill past capacity: inserts start failing, nothing already stored is lost.
+    size_t stored = 0;
+    for (uint64_t i = 100; i < 100 + 4 * map.capacity(); ++i) {
+        stored += map.insert_kv(i, i);
+    }
+    bool bounded = stored < 4 * map.capacity() && map.size() == stored + 2;
+    for (uint64_t i = 100; i < 100 + 4 * map.capacity(); ++i) {
+        map.delete_k(i);
+    }
+    // Churn leaves tombstones behind; inserts must keep finding room.
+    for (uint64_t round = 0; round < 50; ++round) {
+        for (uint64_t i = 0; i < 400; ++i) {
+            bounded = bounded && map.insert_kv(1000 + round * 400 + i, i);
+        }
+        for (uint64_t i = 0; i < 400; ++i) {
+            map.delete_k(1000 + round * 400 + i);
+        }
+    }
+    bounded = bounded && map.size() == 2;
+    Map::remove(name);
+
+    std::cout << "Capacity " << map.capacity() << ", stored " << stored << " before filling up" << std::endl;
+    return ok && bounded;
+}
+
+bool test_processes() {
+    std::cout << "=== Processes Sharing One Segment ===" << std::endl;
+
+    std::string name = segment_name("procs");
+    Map map(name, 20000);
+    std::vector<pid_t> children;
+    for (int p = 0; p < 4; ++p) {
+        pid_t pid = ::fork();
+        if (pid == 0) {
+            // Each child opens the segment by name, like an unrelated process would.
+            Map mine(name, 0);
+            bool ok = true;
+            for (uint64_t i = 0; i < 10000; ++i) {
+                uint64_t key = (i * 4 + p) % 12000;
+                if (mine.get_or_compute(key, [](uint64_t k) { return k * 3; }) != key * 3) {
+                    ok = false;
+                }
+                std::optional<uint64_t> v = mine.lookup_k((key * 7) % 12000);
+                if (v && *v != (key * 7) % 12000 * 3) {
+                    ok = false;
+                }
+            }
+            ::_exit(ok ? 0 : 1);
+        }
+        children.push_back(pid);
+    }
+    // Threads of this process read alongside.
+    std::atomic<int> wrong{0};
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 2; ++t) {
+        readers.emplace_back([&map, &wrong]() {
+            for (uint64_t i = 0; i < 50000; ++i) {
+                std::optional<uint64_t> v = map.lookup_k(i % 12000);
+                if (v && *v != i % 12000 * 3) {
+                    wrong++;
+                }
+            }
+        });
+    }
+    bool children_ok = true;
+    for (pid_t pid : children) {
+        int status = 0;
+        ::waitpid(pid, &status, 0);
+        children_ok = children_ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    }
+    for (auto& t : readers) {
+        t.join();
+    }
+
+    // Between them the children touch every key in [0, 12000).
+    bool complete = map.size() == 12000;
+    for (uint64_t key = 0; key < 12000 && complete; ++key) {
+        complete = map.lookup_k(key) == key * 3;
+    }
+    Map::remove(name);
+
+    std::cout << "Entries: " << map.size() << ", children ok: " << children_ok << ", wrong reads: " << wrong.load()
+              << std::endl;
+    return children_ok && complete && wrong.load() == 0;
+}
+
+bool test_crash_recovery() {
+    std::cout << "=== Crashed Writer Recovery ===" << std::endl;
+
+    std::string name = segment_name("crash");
+    Map map(name, 1000);
+    for (uint64_t i = 0; i < 200; ++i) {
+        map.insert_kv(i, i);
+    }
+
+    // The child dies in the middle of an update, holding the shard lock.
+    int status = run_child([&name]() {
+        Map mine(name, 0);
+        mine.upsert(7, 0, [](uint64_t& v) {
+            v = 12345;
+            ::raise(SIGKILL);
+        });
+        return true;
+    });
+
+    // Lookups and writes on the same shard go on; only key 7 is lost.
+    bool ok = status == -1 && !map.lookup_k(7) && map.insert_kv(7, 70) && map.lookup_k(7) == 70u;
+    for (uint64_t i = 0; i < 200 && ok; ++i) {
+        ok = map.lookup_k(i) == (i == 7 ? 70u : i);
+    }
+    ok = ok && map.size() == 200 && map.recoveries() == 1;
+
+    // A child that exits while merely reading leaves nothing to recover.
+    int reader = run_child([&name]() {
+        Map mine(name, 0);
+        return mine.lookup_k(3) == 3u;
+    });
+    ok = ok && reader == 0 && map.recoveries() == 1;
+    Map::remove(name);
+
+    std::cout << "Recovered: " << ok << std::endl;
+    return ok;
+}
+
+// Hashes like DefaultHash, but once armed (in a child) kills the process on
+// the hash after `crash_after` more. Every map operation hashes its key once
+// up front; compact() hashes each live entry again while rebuilding.
+static int crash_after = -1;
+
+struct CrashingHash {
+    size_t operator()(uint64_t key) const {
+        if (crash_after >= 0 && crash_after-- == 0) {
+            ::raise(SIGKILL);
+        }
+        return DefaultHash<uint64_t>{}(key);
+    }
+};
+
+bool test_compaction_crash() {
+    std::cout << "=== Crash During Compaction ===" << std::endl;
+
+    using CrashMap = SharedHashMap<uint64_t, uint64_t, 1, CrashingHash>;
+    std::string name = segment_name("compact");
+    CrashMap map(name, 200);
+    for (uint64_t i = 0; i < 50; ++i) {
+        map.insert_kv(i, i);
+    }
+
+    // The child churns until tombstones force a compaction, and dies in it.
+    int status = run_child([&name]() {
+        CrashMap mine(name, 0);
+        for (uint64_t i = 1000; i < 1000000; ++i) {
+            crash_after = 1;
+            mine.insert_kv(i, i);
+            crash_after = 1;
+            mine.delete_k(i);
+        }
+        return true;
+    });
+
+    // The first lookup finds the shard mid-change and recovers it: it comes
+    // back empty, but usable.
+    bool ok = status == -1;
+    for (uint64_t i = 0; i < 50 && ok; ++i) {
+        ok = !map.lookup_k(i);
+    }
+    ok = ok && map.recoveries() == 1 && map.size() == 0;
+    for (uint64_t i = 0; i < 50 && ok; ++i) {
+        ok = map.insert_kv(i, i * 2);
+    }
+    for (uint64_t i = 0; i < 50 && ok; ++i) {
+        ok = map.lookup_k(i) == i * 2;
+    }
+    ok = ok && map.size() == 50;
+    CrashMap::remove(name);
+
+    std::cout << "Recovered: " << ok << std::endl;
+    return ok;
+}
+
+bool test_layout_mismatch() {
+    std::cout << "=== Layout Mismatch ===" << std::endl;
+
+    std::string name = segment_name("layout");
+    Map map(name, 100);
+    bool rejected = false;
+    try {
+        SharedHashMap<uint64_t, uint32_t, 8> other(name, 100);
+    } catch (const std::runtime_error&) {
+        rejected = true;
+    }
+    Map::remove(name);
+    return rejected;
+}
+
+int main() {
+    bool ok = test_basic() &&
+              test_processes() &&
+              test_crash_recovery() &&
+              test_compaction_crash() &&
+              test_layout_mismatch();
+
+    if (ok) {
+        std::cout << "✅ TEST PASSED" << std::endl;
+        return 0;
+    }
+    std::cout << "❌ TEST FAILED" << std::endl;
+    return 1;
+}
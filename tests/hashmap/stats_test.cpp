@@ -0,0 +1,77 @@
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include "hashmap/hashmap.h"
+
+// Built against rw_lock_stats, so counters are compiled in.
+static_assert(kStatsEnabled, "stats_test must be built with HASHMAP_ENABLE_STATS");
+
+bool test_lock_counters() {
+    std::cout << "=== RWLock Counters Test ===" << std::endl;
+
+    RWLock lock;
+    lock.read([]() {});
+    lock.write([]() {});
+
+    // A writer holding the lock makes the reader's first attempt fail.
+    std::thread reader;
+    lock.write([&]() {
+        reader = std::thread([&lock]() { lock.read([]() {}); });
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    });
+    reader.join();
+
+    LockStats s = lock.stats();
+    uint64_t timed = 0;
+    for (uint64_t n : s.wait_histogram) {
+        timed += n;
+    }
+    std::cout << "reads=" << s.read_acquisitions << " writes=" << s.write_acquisitions
+              << " contended_reads=" << s.contended_reads << " p50_wait<=" << s.wait_percentile_ns(0.5) << "ns"
+              << std::endl;
+    return s.read_acquisitions == 2 && s.write_acquisitions == 2 && s.contended_reads == 1 &&
+           s.contended_writes == 0 && timed == 1 && s.wait_ns_total >= 10'000'000 &&
+           s.wait_percentile_ns(0.5) >= 10'000'000;
+}
+
+template <template <typename, typename, typename, typename, typename> class Table>
+bool test_map_stats(const std::string& name) {
+    std::cout << "\n=== HashMap Stats Test (" << name << ") ===" << std::endl;
+
+    HashMap<int, int, 4, std::hash<int>, std::equal_to<int>, Table> map;
+    for (int i = 0; i < 1000; ++i) {
+        map.insert_kv(i, i);
+    }
+    for (int i = 0; i < 1500; ++i) {
+        map.lookup_k(i);
+    }
+    map.visit(1, [](const int&) {});
+
+    HashMapStats s = map.stats();
+    uint64_t writes = 0;
+    for (const ShardStats& shard : s.shards) {
+        writes += shard.lock.write_acquisitions;
+    }
+    std::cout << "size=" << s.size << " load=" << s.load_factor << " max_chain=" << s.max_chain
+              << " mean_chain=" << s.mean_chain << " hits=" << s.hits << " misses=" << s.misses << std::endl;
+    return s.size == 1000 && s.shards.size() == 4 && s.hits == 1001 && s.misses == 500 && writes == 1000 &&
+           s.load_factor > 0 && s.load_factor <= 1.0 && s.max_chain >= 1 && s.mean_chain >= 1.0 &&
+           s.mean_chain <= s.max_chain;
+}
+
+int main() {
+    if (!test_lock_counters()) {
+        std::cerr << "❌ RWLock counters test failed" << std::endl;
+        return 1;
+    }
+    if (!test_map_stats<ChainedTable>("ChainedTable") || !test_map_stats<FlatTable>("FlatTable") ||
+        !test_map_stats<InlineTable>("InlineTable")) {
+        std::cerr << "❌ HashMap stats test failed" << std::endl;
+        return 1;
+    }
+    std::cout << "\n✅ Stats tests passed" << std::endl;
+    return 0;
+}
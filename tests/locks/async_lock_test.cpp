@@ -0,0 +1,198 @@
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "hashmap/hashmap.h"
+#include "locks/rw_lock.h"
+
+// Fire-and-forget coroutine: starts eagerly and frees itself when done.
+struct Detached {
+    struct promise_type {
+        Detached get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+// Executor that queues resumptions for an event loop to run.
+struct QueueExecutor {
+    struct Loop {
+        std::mutex mutex;
+        std::deque<std::coroutine_handle<>> ready;
+
+        bool run_one() {
+            std::coroutine_handle<> handle;
+            {
+                std::lock_guard<std::mutex> guard(mutex);
+                if (ready.empty()) {
+                    return false;
+                }
+                handle = ready.front();
+                ready.pop_front();
+            }
+            handle.resume();
+            return true;
+        }
+    };
+
+    Loop* loop;
+
+    void operator()(std::coroutine_handle<> handle) const {
+        std::lock_guard<std::mutex> guard(loop->mutex);
+        loop->ready.push_back(handle);
+    }
+};
+
+// A coroutine hitting a write-locked RWLock suspends instead of blocking, and
+// is resumed through the executor on the loop thread after the writer leaves.
+bool test_suspend_and_executor() {
+    std::cout << "=== Async Lock Suspension Test ===" << std::endl;
+
+    RWLock lock;
+    QueueExecutor::Loop loop;
+    std::atomic<bool> writer_in{false};
+    std::atomic<bool> release{false};
+    int value = 0;
+
+    std::thread writer([&]() {
+        lock.write([&]() {
+            writer_in = true;
+            while (!release.load()) {
+                std::this_thread::yield();
+            }
+            value = 42;
+        });
+    });
+    while (!writer_in.load()) {
+        std::this_thread::yield();
+    }
+
+    std::optional<int> seen;
+    std::thread::id resumed_on;
+    auto reader = [&]() -> Detached {
+        seen = co_await lock.async_read([&]() { return value; }, QueueExecutor{&loop});
+        resumed_on = std::this_thread::get_id();
+    };
+    reader();
+    // Still on this thread: the coroutine is parked, not blocking us.
+    bool suspended = !seen.has_value();
+
+    release = true;
+    writer.join();
+    while (!seen) {
+        loop.run_one();
+    }
+
+    std::cout << "Suspended: " << suspended << ", read " << *seen << std::endl;
+    return suspended && *seen == 42 && resumed_on == std::this_thread::get_id();
+}
+
+// Async and blocking writers mixed on a few threads never lose an update, and
+// queued async readers and writers all get through.
+bool test_mixed_contention() {
+    std::cout << "\n=== Async Lock Contention Test ===" << std::endl;
+
+    RWLock lock;
+    long counter = 0;
+    std::atomic<int> finished{0};
+    std::atomic<long> reads{0};
+    const int coroutines_per_thread = 200;
+    const int num_threads = 4;
+
+    auto worker = [&](int id) -> Detached {
+        for (int i = 0; i < 10; ++i) {
+            if ((id + i) % 3 == 0) {
+                long v = co_await lock.async_read([&]() { return counter; });
+                reads += v >= 0;
+            } else {
+                co_await lock.async_write([&]() { ++counter; });
+            }
+        }
+        finished++;
+    };
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&, t]() {
+            for (int c = 0; c < coroutines_per_thread; ++c) {
+                worker(t * coroutines_per_thread + c);
+                lock.write([&]() { ++counter; });
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    // Inline resumption finishes every coroutine on some releasing thread.
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (finished.load() < num_threads * coroutines_per_thread && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::yield();
+    }
+
+    long writes = 0;
+    for (int id = 0; id < num_threads * coroutines_per_thread; ++id) {
+        for (int i = 0; i < 10; ++i) {
+            writes += (id + i) % 3 != 0;
+        }
+    }
+    long expected = writes + num_threads * coroutines_per_thread;
+    long final_count = lock.read([&]() { return counter; });
+    std::cout << "Finished " << finished.load() << " coroutines, counter " << final_count << "/" << expected
+              << std::endl;
+    return finished.load() == num_threads * coroutines_per_thread && final_count == expected;
+}
+
+bool test_hashmap_async_ops() {
+    std::cout << "\n=== HashMap Async Operations Test ===" << std::endl;
+
+    HashMap<std::string, int, 16> map;
+    QueueExecutor::Loop loop;
+    QueueExecutor executor{&loop};
+    bool ok = false;
+    bool done = false;
+
+    auto run = [&]() -> Detached {
+        for (int i = 0; i < 100; ++i) {
+            co_await map.async_insert_kv("key_" + std::to_string(i), i, executor);
+        }
+        std::optional<int> hit = co_await map.async_lookup_k("key_7", executor);
+        bool deleted = co_await map.async_delete_k("key_7", executor);
+        bool deleted_again = co_await map.async_delete_k("key_7", executor);
+        std::optional<int> miss = co_await map.async_lookup_k("key_7", executor);
+        ok = hit == 7 && deleted && !deleted_again && !miss && map.size() == 99;
+        done = true;
+    };
+    run();
+    while (!done) {
+        loop.run_one();
+    }
+
+    std::cout << "Async insert/lookup/delete: " << (ok ? "ok" : "mismatch") << std::endl;
+    return ok;
+}
+
+int main() {
+    if (!test_suspend_and_executor()) {
+        std::cout << "❌ TEST FAILED - Coroutine was not suspended and resumed correctly" << std::endl;
+        return 1;
+    }
+    if (!test_mixed_contention()) {
+        std::cout << "❌ TEST FAILED - Async lock lost updates or waiters" << std::endl;
+        return 1;
+    }
+    if (!test_hashmap_async_ops()) {
+        std::cout << "❌ TEST FAILED - HashMap async operations" << std::endl;
+        return 1;
+    }
+    std::cout << "\n✅ All async lock tests passed!" << std::endl;
+    return 0;
+}
@@ -1,14 +1,229 @@
 #include <thread>
+#include <atomic>
 #include <vector>
 #include <functional>
 #include <sstream>
 #include <iostream>
 #include <chrono>
 #include <random>
+#include <mutex>
+#include <optional>
+#include <string>
 
 #include "locks/rw_lock.h"
 
+// Records the order in which a first reader ('r'), a writer arriving while it
+// reads ('W') and a reader arriving while that writer waits ('R') get in.
+template <typename Lock>
+std::string late_reader_order() {
+    Lock rwlock;
+    std::mutex order_mutex;
+    std::string order;
+    std::atomic<bool> first_reader_in{false};
+
+    auto record = [&](char c) {
+        std::lock_guard<std::mutex> guard(order_mutex);
+        order += c;
+    };
+
+    std::thread first_reader([&]() {
+        rwlock.read([&]() {
+            first_reader_in = true;
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            record('r');
+        });
+    });
+    while (!first_reader_in.load()) {
+        std::this_thread::yield();
+    }
+
+    std::thread writer([&]() {
+        rwlock.write([&]() { record('W'); });
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+
+    std::thread late_reader([&]() {
+        rwlock.read([&]() { record('R'); });
+    });
+
+    first_reader.join();
+    writer.join();
+    late_reader.join();
+    return order;
+}
+
+// Records the order of a writer holding the lock ('A'), a reader arriving
+// while it writes ('R') and a second writer arriving after that reader ('B').
+template <typename Lock>
+std::string writer_handoff_order() {
+    Lock rwlock;
+    std::mutex order_mutex;
+    std::string order;
+    std::atomic<bool> first_writer_in{false};
+
+    auto record = [&](char c) {
+        std::lock_guard<std::mutex> guard(order_mutex);
+        order += c;
+    };
+
+    std::thread first_writer([&]() {
+        rwlock.write([&]() {
+            first_writer_in = true;
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            record('A');
+        });
+    });
+    while (!first_writer_in.load()) {
+        std::this_thread::yield();
+    }
+
+    std::thread reader([&]() {
+        rwlock.read([&]() { record('R'); });
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    std::thread second_writer([&]() {
+        rwlock.write([&]() { record('B'); });
+    });
+
+    first_writer.join();
+    reader.join();
+    second_writer.join();
+    return order;
+}
+
+// Writer preference: the late reader queues behind the waiting writer, and
+// the second writer overtakes the reader that waited out the first one.
+// Reader preference: the late reader joins the first one. Phase-fair and
+// task-fair: the reader that waited goes before the next writer.
+bool test_fairness_policies() {
+    std::cout << "=== RW Lock Fairness Policies Test ===" << std::endl;
+
+    struct Expected {
+        const char* name;
+        std::string late_reader;
+        std::string handoff;
+        std::string expected_late_reader;
+        std::string expected_handoff;
+    };
+    std::vector<Expected> results = {
+        {"writer preference", late_reader_order<RWLock>(), writer_handoff_order<RWLock>(), "rWR", "ABR"},
+        {"reader preference", late_reader_order<BasicRWLock<ReaderPreference>>(), "", "RrW", ""},
+        {"phase fair", late_reader_order<BasicRWLock<PhaseFair>>(), writer_handoff_order<BasicRWLock<PhaseFair>>(),
+         "rWR", "ARB"},
+        {"task fair", late_reader_order<BasicRWLock<TaskFair>>(), writer_handoff_order<BasicRWLock<TaskFair>>(),
+         "rWR", "ARB"},
+    };
+
+    bool ok = true;
+    for (const Expected& r : results) {
+        std::cout << r.name << ": " << r.late_reader << " " << r.handoff << std::endl;
+        ok &= r.late_reader == r.expected_late_reader && r.handoff == r.expected_handoff;
+    }
+    return ok;
+}
+
+// try_* never wait; try_*_for give up after the timeout, and a writer that
+// gave up does not keep holding readers off.
+template <typename Lock>
+bool try_and_timed_locking() {
+    Lock rwlock;
+    bool ok = true;
+
+    ok &= rwlock.try_write([]() { return 1; }) == std::optional<int>(1);
+    rwlock.read([&]() {
+        ok &= rwlock.try_read([]() {}) == true;
+        ok &= rwlock.try_write([]() {}) == false;
+
+        std::thread writer([&]() {
+            auto start = std::chrono::steady_clock::now();
+            bool acquired = rwlock.try_write_for(std::chrono::milliseconds(20), []() {});
+            ok &= !acquired && std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(20);
+        });
+        writer.join();
+        ok &= rwlock.try_read([]() {}) == true;
+    });
+
+    std::atomic<bool> writer_in{false};
+    std::atomic<bool> release{false};
+    std::thread writer([&]() {
+        rwlock.write([&]() {
+            writer_in = true;
+            while (!release.load()) {
+                std::this_thread::yield();
+            }
+        });
+    });
+    while (!writer_in.load()) {
+        std::this_thread::yield();
+    }
+    ok &= !rwlock.try_read_for(std::chrono::milliseconds(10), []() {});
+    release = true;
+    writer.join();
+    ok &= rwlock.try_read_for(std::chrono::milliseconds(10), []() { return 7; }) == std::optional<int>(7);
+    return ok;
+}
+
+bool test_try_and_timed() {
+    std::cout << "\n=== RW Lock Try/Timed Test ===" << std::endl;
+    bool ok = try_and_timed_locking<RWLock>() && try_and_timed_locking<BasicRWLock<ReaderPreference>>() &&
+              try_and_timed_locking<BasicRWLock<PhaseFair>>() && try_and_timed_locking<BasicRWLock<TaskFair>>();
+    std::cout << "Try/timed locking: " << (ok ? "ok" : "mismatch") << std::endl;
+    return ok;
+}
+
+// Upgraders read a counter and write back one more under a single upgradable
+// acquisition while plain writers and readers hammer the lock; no update may
+// be lost, so nobody may write between an upgrader's read and its upgrade.
+template <typename Lock>
+bool upgradable_counter() {
+    Lock rwlock;
+    long counter = 0;
+    const int iterations = 2000;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 6; ++t) {
+        threads.emplace_back([&, t]() {
+            for (int i = 0; i < iterations; ++i) {
+                if (t < 3) {
+                    rwlock.upgradable([&](auto& upgrade) {
+                        long seen = counter;
+                        upgrade.write([&]() { counter = seen + 1; });
+                    });
+                } else if (t < 5) {
+                    rwlock.write([&]() { ++counter; });
+                } else {
+                    rwlock.read([&]() { return counter; });
+                }
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    return counter == 5L * iterations;
+}
+
+bool test_upgradable() {
+    std::cout << "\n=== RW Lock Upgradable Test ===" << std::endl;
+    bool ok = upgradable_counter<RWLock>() && upgradable_counter<BasicRWLock<ReaderPreference>>() &&
+              upgradable_counter<BasicRWLock<PhaseFair>>() && upgradable_counter<BasicRWLock<TaskFair>>();
+    std::cout << "Upgradable counter: " << (ok ? "ok" : "lost updates") << std::endl;
+    return ok;
+}
+
 int main() {
+    if (!test_fairness_policies()) {
+        std::cout << "❌ TEST FAILED - Lock admitted readers and writers in the wrong order" << std::endl;
+        return 1;
+    }
+    if (!test_try_and_timed()) {
+        std::cout << "❌ TEST FAILED - try/timed locking" << std::endl;
+        return 1;
+    }
+    if (!test_upgradable()) {
+        std::cout << "❌ TEST FAILED - Upgradable lock lost updates" << std::endl;
+        return 1;
+    }
+
     std::cout << "=== RW Lock Basic Test ===" << std::endl;
     
     RWLock rwlock;